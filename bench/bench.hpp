@@ -0,0 +1,67 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace poly::bench
+{
+/**
+ * @brief Read the cycle counter of the CPU, or 0 where there is none.
+ */
+inline uint64_t cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Report the average number of cycles per item of a benchmark.
+ * @param state The benchmark state.
+ * @param start_cycles The value of `cycles()` before the benchmark loop.
+ * @param items_per_iteration The number of items handled by each iteration of the loop.
+ */
+inline void report_cycles(benchmark::State& state, uint64_t start_cycles, int64_t items_per_iteration = 1)
+{
+    const auto items = static_cast<double>(state.iterations() * items_per_iteration);
+    state.counters["cycles/item"] = benchmark::Counter(static_cast<double>(cycles() - start_cycles) / items);
+}
+
+/**
+ * @brief Nanoseconds on the steady clock, for latencies measured inside callbacks.
+ */
+inline int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}
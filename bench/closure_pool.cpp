@@ -0,0 +1,87 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "bench.hpp"
+
+#include "poly/irq_closure_pool.hpp"
+#include "poly/irq_event.hpp"
+#include "poly/irq_event_runtime.hpp"
+
+#include <deque>
+
+namespace
+{
+constexpr size_t burst = 64;
+uint32_t sum = 0;
+
+void add_one()
+{
+    sum += 1;
+}
+
+// Each unit of work is a statically allocated event with a function pointer callback
+void BM_Post_StaticEvents(benchmark::State& state)
+{
+    poly::irq_event_runtime rt;
+    std::deque<poly::irq_event<void>> events;
+    for(size_t i = 0; i < burst; i++)
+    {
+        events.emplace_back(rt, add_one);
+    }
+    const uint64_t start_cycles = poly::bench::cycles();
+    for(auto _: state)
+    {
+        for(auto& evt: events)
+        {
+            evt.post(poly::irq_baton{});
+        }
+        rt.run_available();
+    }
+    poly::bench::report_cycles(state, start_cycles, burst);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(burst));
+    benchmark::DoNotOptimize(sum);
+}
+
+// Each unit of work is a capturing lambda stored in a node from the pool
+void BM_Post_ClosurePool(benchmark::State& state)
+{
+    poly::irq_event_runtime rt;
+    poly::irq_closure_pool<burst> pool(rt);
+    uint32_t step = 1;
+    const uint64_t start_cycles = poly::bench::cycles();
+    for(auto _: state)
+    {
+        for(size_t i = 0; i < burst; i++)
+        {
+            auto res = pool.post(poly::irq_baton{}, [&step]() { sum += step; });
+            benchmark::DoNotOptimize(res);
+        }
+        rt.run_available();
+    }
+    poly::bench::report_cycles(state, start_cycles, burst);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(burst));
+    benchmark::DoNotOptimize(sum);
+}
+}
+
+BENCHMARK(BM_Post_StaticEvents);
+BENCHMARK(BM_Post_ClosurePool);
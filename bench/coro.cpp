@@ -0,0 +1,101 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "bench.hpp"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include "poly/coro.hpp"
+#include "poly/irq_event.hpp"
+#include "poly/irq_event_runtime.hpp"
+
+namespace
+{
+int sum = 0;
+
+void on_value(etl::optional<int> value)
+{
+    sum += *value;
+}
+
+// An IRQ delivers a value to a callback
+void BM_Resume_Callback(benchmark::State& state)
+{
+    poly::irq_event_runtime rt;
+    poly::irq_event<int> event(rt, on_value);
+    const uint64_t start_cycles = poly::bench::cycles();
+    for(auto _: state)
+    {
+        event.try_post(poly::irq_baton{}, 1);
+        rt.run_available();
+    }
+    poly::bench::report_cycles(state, start_cycles);
+    benchmark::DoNotOptimize(sum);
+}
+
+poly::coro::task<> accumulate(poly::coro::irq_awaitable<int>& source)
+{
+    while(true)
+    {
+        int value = co_await source;
+        if(value < 0)
+        {
+            co_return;
+        }
+        sum += value;
+    }
+}
+
+// An IRQ delivers a value to a coroutine waiting in co_await
+void BM_Resume_Coroutine(benchmark::State& state)
+{
+    poly::coro::frame_pool<256, 1> frames;
+    poly::coro::set_frame_allocator(frames.allocator());
+    poly::irq_event_runtime rt;
+    poly::coro::irq_awaitable<int> source(rt);
+    auto task = accumulate(source);
+    task.start();
+
+    const uint64_t start_cycles = poly::bench::cycles();
+    for(auto _: state)
+    {
+        source.try_post(poly::irq_baton{}, 1);
+        rt.run_available();
+    }
+    poly::bench::report_cycles(state, start_cycles);
+    benchmark::DoNotOptimize(sum);
+
+    source.try_post(poly::irq_baton{}, -1);
+    rt.run_available();
+    if(!task.done())
+    {
+        state.SkipWithError("The coroutine did not complete");
+    }
+    task = {};
+    poly::coro::set_frame_allocator({});
+}
+}
+
+BENCHMARK(BM_Resume_Callback);
+BENCHMARK(BM_Resume_Coroutine);
+
+#endif
@@ -0,0 +1,176 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "bench.hpp"
+
+#include "poly/irq_event.hpp"
+#include "poly/irq_event_runtime.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+uint32_t callback_count = 0;
+
+void count_callback()
+{
+    callback_count++;
+}
+
+// The dispatch used before the trampoline: a virtual run_callback in the base
+// that clears the posted flag and calls the stored callback of the derived event.
+class virtual_event_base
+{
+public:
+    std::atomic<virtual_event_base*> next_{nullptr};
+    virtual ~virtual_event_base() = default;
+    virtual void run_callback() = 0;
+};
+
+class virtual_event final: public virtual_event_base
+{
+    std::atomic<bool> is_posted_{false};
+    void (*cb_)() = count_callback;
+    void* rt_ = nullptr;
+public:
+    void run_callback() override
+    {
+        is_posted_.store(false);
+        cb_();
+    }
+};
+
+// The same events without the posted flag, to compare only the cost of the indirection.
+// Four kinds of events with different callbacks are mixed, as in an application.
+template<int Kind>
+void kind_callback()
+{
+    callback_count += Kind;
+}
+
+template<int Kind>
+class bare_virtual_event final: public virtual_event_base
+{
+    void (*cb_)() = kind_callback<Kind>;
+public:
+    void run_callback() override
+    {
+        cb_();
+    }
+};
+
+template<int Kind>
+struct bare_trampoline_event final: poly::detail::irq_event_base
+{
+    void (*cb_)() = kind_callback<Kind>;
+
+    bare_trampoline_event(): poly::detail::irq_event_base(run_event) {}
+
+    static void run_event(poly::detail::irq_event_base& base)
+    {
+        static_cast<bare_trampoline_event&>(base).cb_();
+    }
+};
+
+constexpr size_t num_events = 256;
+
+template<template<int> class Event, class Base>
+void BM_Dispatch_Bare(benchmark::State& state)
+{
+    std::deque<Event<1>> kind1(num_events / 4);
+    std::deque<Event<2>> kind2(num_events / 4);
+    std::deque<Event<3>> kind3(num_events / 4);
+    std::deque<Event<4>> kind4(num_events / 4);
+    std::vector<Base*> events;
+    for(size_t i = 0; i < num_events / 4; i++)
+    {
+        events.push_back(&kind1[i]);
+        events.push_back(&kind2[i]);
+        events.push_back(&kind3[i]);
+        events.push_back(&kind4[i]);
+    }
+    std::shuffle(events.begin(), events.end(), std::mt19937(42));
+
+    const uint64_t start_cycles = poly::bench::cycles();
+    for(auto _: state)
+    {
+        for(auto* evt: events)
+        {
+            evt->run_callback();
+        }
+    }
+    poly::bench::report_cycles(state, start_cycles, num_events);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(num_events));
+}
+
+void BM_Dispatch_Virtual(benchmark::State& state)
+{
+    std::vector<std::unique_ptr<virtual_event_base>> events;
+    for(size_t i = 0; i < num_events; i++)
+    {
+        events.emplace_back(new virtual_event);
+    }
+    const uint64_t start_cycles = poly::bench::cycles();
+    for(auto _: state)
+    {
+        for(auto& evt: events)
+        {
+            evt->run_callback();
+        }
+    }
+    poly::bench::report_cycles(state, start_cycles, num_events);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(num_events));
+    state.counters["sizeof"] = benchmark::Counter(sizeof(virtual_event));
+}
+
+void BM_Dispatch_Trampoline(benchmark::State& state)
+{
+    poly::irq_event_runtime rt;
+    std::vector<std::unique_ptr<poly::irq_event<void>>> events;
+    for(size_t i = 0; i < num_events; i++)
+    {
+        events.emplace_back(new poly::irq_event<void>(rt, count_callback));
+    }
+    const uint64_t start_cycles = poly::bench::cycles();
+    for(auto _: state)
+    {
+        for(auto& evt: events)
+        {
+            poly::detail::irq_event_base& base = *evt;
+            base.run_callback();
+        }
+    }
+    poly::bench::report_cycles(state, start_cycles, num_events);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(num_events));
+    state.counters["sizeof"] = benchmark::Counter(sizeof(poly::irq_event<void>));
+}
+}
+
+BENCHMARK_TEMPLATE(BM_Dispatch_Bare, bare_virtual_event, virtual_event_base);
+BENCHMARK_TEMPLATE(BM_Dispatch_Bare, bare_trampoline_event, poly::detail::irq_event_base);
+BENCHMARK(BM_Dispatch_Virtual);
+BENCHMARK(BM_Dispatch_Trampoline);
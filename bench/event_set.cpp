@@ -0,0 +1,101 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "bench.hpp"
+
+#include "poly/irq_event_set.hpp"
+#include "poly/pc/thread_pool_runtime.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr int posts_per_producer = 10000;
+std::atomic<int> received{0};
+
+void on_item(etl::optional<int>)
+{
+    received.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Single producer posts from the benchmark thread and drains on the same thread, for the cost of the rings alone
+template<class Set>
+void BM_Set_PostDrain(benchmark::State& state)
+{
+    poly::irq_event_runtime rt;
+    Set set(rt, on_item);
+    const uint64_t start_cycles = poly::bench::cycles();
+    for(auto _: state)
+    {
+        for(int i = 0; i < 64; i++)
+        {
+            auto res = set.post(poly::irq_baton{}, i);
+            benchmark::DoNotOptimize(res);
+        }
+        rt.run_available();
+    }
+    poly::bench::report_cycles(state, start_cycles, 64);
+    state.SetItemsProcessed(state.iterations() * 64);
+}
+
+// Producers post concurrently to one set, a single worker runs the set
+void BM_MpmcSet_Producers(benchmark::State& state)
+{
+    const int num_producers = static_cast<int>(state.range(0));
+    poly::pc::thread_pool_runtime rt(1);
+    poly::irq_event_mpmc_set<int, 256> set(rt, on_item);
+
+    for(auto _: state)
+    {
+        received.store(0);
+        std::vector<std::thread> producers;
+        for(int p = 0; p < num_producers; p++)
+        {
+            producers.emplace_back([&set]() {
+                for(int i = 0; i < posts_per_producer; i++)
+                {
+                    // Retry when the set is full, the worker makes room
+                    while(set.post(poly::irq_baton{}, i).is_error())
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for(auto& t: producers)
+        {
+            t.join();
+        }
+        while(received.load() < num_producers * posts_per_producer)
+        {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * num_producers * posts_per_producer);
+}
+}
+
+BENCHMARK_TEMPLATE(BM_Set_PostDrain, poly::irq_event_set<int, 64>);
+BENCHMARK_TEMPLATE(BM_Set_PostDrain, poly::irq_event_mpmc_set<int, 64>);
+BENCHMARK(BM_MpmcSet_Producers)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
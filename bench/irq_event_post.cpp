@@ -0,0 +1,73 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "bench.hpp"
+
+#include "poly/irq_event.hpp"
+#include "poly/irq_event_runtime.hpp"
+
+namespace
+{
+uint32_t sum = 0;
+
+void on_value(etl::optional<uint32_t> value)
+{
+    sum += *value;
+}
+
+// The interrupt side: store a value and post the event, then let the runtime take it
+void BM_IrqEvent_SetDataThenPost(benchmark::State& state)
+{
+    poly::irq_event_runtime rt;
+    poly::irq_event<uint32_t> event(rt, on_value);
+    uint32_t value = 0;
+    const uint64_t start_cycles = poly::bench::cycles();
+    for(auto _: state)
+    {
+        event.try_set_data(poly::irq_baton{}, value++);
+        event.post(poly::irq_baton{});
+        rt.run_available();
+    }
+    poly::bench::report_cycles(state, start_cycles);
+    state.counters["sizeof"] = benchmark::Counter(sizeof(poly::irq_event<uint32_t>));
+    benchmark::DoNotOptimize(sum);
+}
+
+void BM_IrqEvent_TryPost(benchmark::State& state)
+{
+    poly::irq_event_runtime rt;
+    poly::irq_event<uint32_t> event(rt, on_value);
+    uint32_t value = 0;
+    const uint64_t start_cycles = poly::bench::cycles();
+    for(auto _: state)
+    {
+        event.try_post(poly::irq_baton{}, value++);
+        rt.run_available();
+    }
+    poly::bench::report_cycles(state, start_cycles);
+    state.counters["sizeof"] = benchmark::Counter(sizeof(poly::irq_event<uint32_t>));
+    benchmark::DoNotOptimize(sum);
+}
+}
+
+BENCHMARK(BM_IrqEvent_SetDataThenPost);
+BENCHMARK(BM_IrqEvent_TryPost);
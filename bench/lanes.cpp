@@ -0,0 +1,79 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "bench.hpp"
+
+#include "poly/detail/irq_event_mpsc_lane.hpp"
+#include "poly/detail/irq_event_stack_lane.hpp"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+// Padded to a cache line, like an event with some data
+struct alignas(64) bench_event final: poly::detail::irq_event_base
+{
+    bench_event(): poly::detail::irq_event_base([](poly::detail::irq_event_base&) {}) {}
+};
+
+template<class Lane>
+void BM_LaneDrain(benchmark::State& state)
+{
+    const auto burst = static_cast<size_t>(state.range(0));
+    Lane lane;
+    std::vector<bench_event> events(burst);
+    // Events are posted in a scattered order, as they are spread over memory in an application
+    std::vector<bench_event*> order;
+    for(auto& evt: events)
+    {
+        order.push_back(&evt);
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+    std::vector<int64_t> drain_ns;
+    const uint64_t start_cycles = poly::bench::cycles();
+    for(auto _: state)
+    {
+        for(auto* evt: order)
+        {
+            lane.push(*evt);
+        }
+        // Time from the start of the drain until the last event of the burst has run
+        const int64_t drain_start = poly::bench::now_ns();
+        while(auto* evt = lane.pop())
+        {
+            evt->run_callback();
+        }
+        drain_ns.push_back(poly::bench::now_ns() - drain_start);
+    }
+    poly::bench::report_cycles(state, start_cycles, static_cast<int64_t>(burst));
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(burst));
+    // Tail latency of the last event in a burst, the maximum is dominated by preemption
+    std::sort(drain_ns.begin(), drain_ns.end());
+    state.counters["p99_drain_ns"] = benchmark::Counter(static_cast<double>(drain_ns[drain_ns.size() * 99 / 100]));
+}
+}
+
+BENCHMARK_TEMPLATE(BM_LaneDrain, poly::detail::irq_event_stack_lane)->RangeMultiplier(10)->Range(10, 10000);
+BENCHMARK_TEMPLATE(BM_LaneDrain, poly::detail::irq_event_mpsc_lane)->RangeMultiplier(10)->Range(10, 10000);
@@ -0,0 +1,109 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "bench.hpp"
+
+#include "poly/irq_event.hpp"
+#include "poly/irq_event_runtime.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace
+{
+// The high priority event is posted from the first low priority callback, like an interrupt
+// that arrives while the runtime is busy with a flood of low priority events.
+struct flood_state
+{
+    poly::irq_event<void>* high = nullptr;
+    bool high_posted = false;
+    int64_t high_post_ns = 0;
+    int64_t latency_ns = 0;
+};
+
+flood_state flood;
+
+void low_callback()
+{
+    // Some work, like formatting a log line
+    volatile uint32_t sink = 0;
+    for(uint32_t i = 0; i < 64; i++)
+    {
+        sink = sink + i;
+    }
+    if(!flood.high_posted)
+    {
+        flood.high_posted = true;
+        flood.high_post_ns = poly::bench::now_ns();
+        flood.high->post(poly::irq_baton{});
+    }
+}
+
+void high_callback()
+{
+    flood.latency_ns = poly::bench::now_ns() - flood.high_post_ns;
+}
+
+template<class Runtime>
+void run_flood(benchmark::State& state, uint8_t low_priority)
+{
+    const auto num_low = static_cast<size_t>(state.range(0));
+    Runtime rt;
+    std::unique_ptr<poly::irq_event<void>[]> low(new poly::irq_event<void>[num_low]);
+    for(size_t i = 0; i < num_low; i++)
+    {
+        low[i].late_init(rt, low_callback, low_priority);
+    }
+    poly::irq_event<void> high(rt, high_callback, 0);
+    flood.high = &high;
+
+    std::vector<int64_t> latencies;
+    for(auto _: state)
+    {
+        flood.high_posted = false;
+        for(size_t i = 0; i < num_low; i++)
+        {
+            low[i].post(poly::irq_baton{});
+        }
+        rt.run_available();
+        latencies.push_back(flood.latency_ns);
+    }
+    // The maximum is dominated by preemption of the benchmark thread, the 99th percentile is not
+    std::sort(latencies.begin(), latencies.end());
+    state.counters["p50_latency_ns"] = benchmark::Counter(static_cast<double>(latencies[latencies.size() / 2]));
+    state.counters["p99_latency_ns"] = benchmark::Counter(static_cast<double>(latencies[latencies.size() * 99 / 100]));
+}
+
+void BM_HighPriorityLatency_SingleLane(benchmark::State& state)
+{
+    run_flood<poly::irq_event_runtime>(state, 0);
+}
+
+void BM_HighPriorityLatency_TwoLanes(benchmark::State& state)
+{
+    run_flood<poly::basic_irq_event_runtime<2>>(state, 1);
+}
+}
+
+BENCHMARK(BM_HighPriorityLatency_SingleLane)->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK(BM_HighPriorityLatency_TwoLanes)->Arg(10)->Arg(100)->Arg(1000);
@@ -0,0 +1,57 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "bench.hpp"
+
+#include "poly/irq_event_reduce.hpp"
+#include "poly/irq_event_runtime.hpp"
+
+namespace
+{
+uint64_t total = 0;
+
+void on_value(uint32_t value)
+{
+    total += value;
+}
+
+// Posts that find the event already posted, the runtime runs it once per batch
+void BM_Reduce_PostBatch(benchmark::State& state)
+{
+    const auto batch = static_cast<uint32_t>(state.range(0));
+    poly::irq_event_runtime rt;
+    poly::irq_event_reduce<uint32_t, poly::reduce_add> counter(rt, on_value);
+    const uint64_t start_cycles = poly::bench::cycles();
+    for(auto _: state)
+    {
+        for(uint32_t i = 0; i < batch; i++)
+        {
+            counter.post(poly::irq_baton{}, 1);
+        }
+        rt.run_available();
+    }
+    poly::bench::report_cycles(state, start_cycles, batch);
+    benchmark::DoNotOptimize(total);
+}
+}
+
+BENCHMARK(BM_Reduce_PostBatch)->Arg(1)->Arg(16);
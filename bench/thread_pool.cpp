@@ -0,0 +1,84 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "bench.hpp"
+
+#include "poly/irq_event.hpp"
+#include "poly/pc/thread_pool_runtime.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace
+{
+constexpr int num_events = 1024;
+std::atomic<int> remaining{0};
+
+// Simulated work of a callback, about a microsecond
+void work()
+{
+    uint32_t x = 1;
+    for(int i = 0; i < 1000; i++)
+    {
+        x = x * 1664525u + 1013904223u;
+    }
+    benchmark::DoNotOptimize(x);
+    remaining.fetch_sub(1, std::memory_order_release);
+}
+
+void BM_ThreadPool_Scaling(benchmark::State& state)
+{
+    poly::pc::thread_pool_runtime rt(static_cast<std::size_t>(state.range(0)));
+    std::unique_ptr<poly::irq_event<void>[]> events(new poly::irq_event<void>[num_events]);
+    for(int i = 0; i < num_events; i++)
+    {
+        events[i].late_init(rt, work);
+    }
+    for(auto _: state)
+    {
+        remaining.store(num_events, std::memory_order_relaxed);
+        for(int i = 0; i < num_events; i++)
+        {
+            events[i].post(poly::irq_baton{});
+        }
+        while(remaining.load(std::memory_order_acquire) > 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * num_events);
+}
+
+void worker_counts(benchmark::internal::Benchmark* bench)
+{
+    const int max_workers = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for(int workers = 1; workers < max_workers; workers *= 2)
+    {
+        bench->Arg(workers);
+    }
+    bench->Arg(max_workers);
+}
+}
+
+BENCHMARK(BM_ThreadPool_Scaling)->Apply(worker_counts)->UseRealTime();
@@ -0,0 +1,139 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "bench.hpp"
+
+#include "poly/irq_event_runtime.hpp"
+#include "poly/timer.hpp"
+
+#include <memory>
+#include <random>
+
+namespace
+{
+void (*clock_irq)() = nullptr;
+size_t clock_timeout = 0;
+bool clock_fired = false;
+
+void clock_start(void (*irq_callback)(), size_t timeout_ms)
+{
+    clock_irq = irq_callback;
+    clock_timeout = timeout_ms;
+}
+
+size_t clock_stop()
+{
+    // The full timeout has elapsed when the interrupt fired, otherwise no time has passed
+    size_t elapsed = clock_fired ? clock_timeout : 0;
+    clock_fired = false;
+    return elapsed;
+}
+
+void rearm(poly::deadline_timer& timer)
+{
+    timer.async_wait(timer.get_timeout());
+}
+
+// Cost of one clock interrupt that expires a 1 ms timer, while other timers with long timeouts are armed
+void BM_Timer_Tick(benchmark::State& state)
+{
+    const auto num_armed = static_cast<size_t>(state.range(0));
+    poly::irq_event_runtime rt;
+    poly::timer_clock clk;
+    clk.start = clock_start;
+    clk.stop = clock_stop;
+    poly::timer_task::init(rt, clk);
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int64_t> timeouts(10000, 600000);
+    std::unique_ptr<poly::deadline_timer[]> armed(new poly::deadline_timer[num_armed]);
+    for(size_t i = 0; i < num_armed; i++)
+    {
+        armed[i].async_wait(rearm, poly::chrono::milliseconds(timeouts(rng)));
+    }
+    poly::deadline_timer ticker;
+    ticker.async_wait(rearm, 1_ms);
+    rt.run_available();
+
+    const uint64_t start_cycles = poly::bench::cycles();
+    for(auto _: state)
+    {
+        clock_fired = true;
+        clock_irq();
+        rt.run_available();
+    }
+    poly::bench::report_cycles(state, start_cycles);
+
+    ticker.cancel();
+    for(size_t i = 0; i < num_armed; i++)
+    {
+        armed[i].cancel();
+    }
+}
+
+// 500 timers with timeouts staggered 7 ms apart, each allowed the given percentage of its timeout as slack
+void BM_Timer_Staggered(benchmark::State& state)
+{
+    constexpr size_t num_timers = 500;
+    const auto slack_percent = state.range(0);
+    poly::irq_event_runtime rt;
+    poly::timer_clock clk;
+    clk.start = clock_start;
+    clk.stop = clock_stop;
+    poly::timer_task::init(rt, clk);
+    rt.run_available();
+    poly::timer_service& service = *poly::timer_task::default_service();
+
+    size_t fired = 0;
+    std::unique_ptr<poly::deadline_timer[]> timers(new poly::deadline_timer[num_timers]);
+    for(size_t i = 0; i < num_timers; i++)
+    {
+        timers[i].set_handler([&fired](poly::deadline_timer&) { fired++; });
+    }
+    service.reset_statistics();
+
+    const uint64_t start_cycles = poly::bench::cycles();
+    for(auto _: state)
+    {
+        for(size_t i = 0; i < num_timers; i++)
+        {
+            const poly::chrono::milliseconds timeout(static_cast<int64_t>(1000 + i * 7));
+            timers[i].async_wait(timeout, timeout * slack_percent / 100);
+        }
+        rt.run_available();
+        fired = 0;
+        while(fired < num_timers)
+        {
+            clock_fired = true;
+            clock_irq();
+            rt.run_available();
+        }
+    }
+    poly::bench::report_cycles(state, start_cycles, num_timers);
+    state.counters["wakeups"] = benchmark::Counter(service.wakeups(), benchmark::Counter::kAvgIterations);
+    state.counters["wakeups_saved"] = benchmark::Counter(service.wakeups_saved(), benchmark::Counter::kAvgIterations);
+    state.counters["clock_starts"] = benchmark::Counter(service.clock_starts(), benchmark::Counter::kAvgIterations);
+}
+}
+
+BENCHMARK(BM_Timer_Tick)->Arg(10)->Arg(100)->Arg(1000)->Arg(2000)->Arg(10000);
+BENCHMARK(BM_Timer_Staggered)->Arg(0)->Arg(10)->Arg(25);
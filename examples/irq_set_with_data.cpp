@@ -49,6 +49,7 @@ int main() {
     });
 
     while(true) {
+        irq_rt.wait_for_events();
         irq_rt.run_available();
     }
 }
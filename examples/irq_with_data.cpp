@@ -21,12 +21,12 @@ int main() {
             std::this_thread::sleep_for(std::chrono::seconds(1));
             auto value = rand();
             std::cout << "Sending  " << value << std::endl;
-            random_evt.try_set_data(poly::irq_baton{}, value);
-            random_evt.post(poly::irq_baton{});
+            random_evt.try_post(poly::irq_baton{}, value);
         }
     });
 
     while(true) {
+        irq_rt.wait_for_events();
         irq_rt.run_available();
     }
 }
\ No newline at end of file
@@ -50,10 +50,17 @@ static std::size_t stop() {
     return 0;
 }
 
-void timer1_cb(poly::deadline_timer& timer) {
-    std::cout << "Timer 1 timeout" << std::endl;
+static std::size_t elapsed() {
+    if(timer_data_) {
+        auto now = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(now - timer_data_->start_time).count();
+    }
+    return 0;
+}
+
+void timer1_cb(poly::periodic_timer& timer) {
+    std::cout << "Timer 1 timeout, missed periods = " << timer.missed_periods() << std::endl;
     std::cout << "This thread = " << std::this_thread::get_id() << std::endl;
-    timer.async_wait(1_sec);
 }
 
 void timer2_cb(poly::deadline_timer& timer) {
@@ -66,17 +73,19 @@ int main() {
     poly::timer_clock clk;
     clk.start = start;
     clk.stop = stop;
+    clk.elapsed = elapsed;
     poly::irq_event_runtime irq_rt;
     poly::timer_task::init(irq_rt, clk);
 
-    poly::deadline_timer timer1;
+    poly::periodic_timer timer1;
     poly::deadline_timer timer2;
 
-    timer1.async_wait(timer1_cb, 1_sec);
+    timer1.start(timer1_cb, 1_sec);
     timer2.async_wait(timer2_cb, 1_sec);
 
     std::cout << "This thread = " << std::this_thread::get_id() << std::endl;
     while(true) {
+        irq_rt.wait_for_events();
         irq_rt.run_available();
     }
 }
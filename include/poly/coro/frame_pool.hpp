@@ -0,0 +1,131 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "poly/alloc/slot_allocator.hpp"
+
+#include <stddef.h>
+
+namespace poly::coro
+{
+/**
+ * @brief Allocator used for coroutine frames of `poly::coro::task`.
+ *
+ * This is implemented as a C struct, like `timer_clock`, so that frames can be placed in any memory the
+ * application chooses. `allocate` returns nullptr when no frame of `size` bytes is available.
+ */
+struct frame_allocator
+{
+    /**
+     * @brief User context passed to the functions.
+     */
+    void* context = nullptr;
+    void* (*allocate)(void* context, size_t size) = nullptr;
+    void (*deallocate)(void* context, void* frame) = nullptr;
+};
+
+namespace detail
+{
+inline frame_allocator current_frame_allocator{};
+}
+
+/**
+ * @brief Set the allocator used for coroutine frames.
+ * @param allocator The allocator.
+ *
+ * Frames are returned to the allocator that is current when they are freed, so the allocator must not be
+ * changed while any frame is alive.
+ */
+inline void set_frame_allocator(frame_allocator allocator)
+{
+    detail::current_frame_allocator = allocator;
+}
+
+/**
+ * @brief A fixed pool of equally sized coroutine frames.
+ * @tparam FrameSize The largest frame that can be allocated, in bytes.
+ * @tparam Frames The number of frames in the pool.
+ *
+ * Frames are allocated and freed from the context running the coroutines. Typical usage is a statically
+ * allocated pool that is installed with `set_frame_allocator(pool.allocator())`.
+ */
+template<size_t FrameSize, size_t Frames>
+class frame_pool
+{
+    struct alignas(alignof(max_align_t)) frame
+    {
+        unsigned char storage[FrameSize];
+    };
+
+    alloc::slot_allocator<frame, Frames> frames_;
+
+    static void* allocate(void* context, size_t size)
+    {
+        if(size > FrameSize)
+        {
+            return nullptr;
+        }
+        return static_cast<frame_pool*>(context)->frames_.try_allocate();
+    }
+
+    static void deallocate(void* context, void* ptr)
+    {
+        static_cast<frame_pool*>(context)->frames_.try_deallocate(static_cast<frame*>(ptr));
+    }
+public:
+    frame_pool() = default;
+    frame_pool(const frame_pool&) = delete;
+    frame_pool& operator=(const frame_pool&) = delete;
+
+    /**
+     * @brief Get an allocator handing out frames from this pool.
+     */
+    frame_allocator allocator()
+    {
+        return frame_allocator{this, allocate, deallocate};
+    }
+};
+
+namespace detail
+{
+/**
+ * @brief Allocate a coroutine frame from the current allocator.
+ * @return nullptr if no allocator is set or it is exhausted.
+ */
+inline void* allocate_frame(size_t size) noexcept
+{
+    auto& allocator = current_frame_allocator;
+    if(allocator.allocate == nullptr)
+    {
+        return nullptr;
+    }
+    return allocator.allocate(allocator.context, size);
+}
+
+inline void deallocate_frame(void* frame) noexcept
+{
+    auto& allocator = current_frame_allocator;
+    allocator.deallocate(allocator.context, frame);
+}
+}
+}
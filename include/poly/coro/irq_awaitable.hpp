@@ -0,0 +1,264 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#if !defined(__cpp_impl_coroutine) || !__has_include(<coroutine>)
+#error "poly/coro requires C++20 coroutine support"
+#endif
+
+#include "poly/detail/irq_event_base.hpp"
+#include "poly/detail/irq_event_state.hpp"
+#include "poly/irq_event_runtime.hpp"
+#include "poly/manual_lifetime.hpp"
+
+#include "etl/atomic.h"
+#include "etl/optional.h"
+#include "etl/utility.h"
+
+#include <assert.h>
+#include <coroutine>
+#include <cstdint>
+
+namespace poly::coro
+{
+/**
+ * @brief An IRQ event that a coroutine can `co_await`.
+ * @tparam T The data passed from the interrupt to the coroutine.
+ *
+ * Data is posted from interrupt context like with `irq_event<T>`. When the runtime runs the event, the
+ * waiting coroutine is resumed from `irq_event_runtime::run_available` with the data. Data posted while no
+ * coroutine is waiting is kept and returned by the next `co_await`, newer data replaces older data.
+ *
+ * Only one coroutine may wait at a time.
+ */
+template<class T>
+class irq_awaitable final: public poly::detail::irq_event_base
+{
+    static constexpr uint8_t posted_bit = poly::detail::irq_event_state::posted_bit;
+    static constexpr uint8_t writing_bit = poly::detail::irq_event_state::writing_bit;
+    static constexpr uint8_t has_data_bit = poly::detail::irq_event_state::has_data_bit;
+
+    etl::atomic<uint8_t> state_{0};
+    manual_lifetime<T> data_;
+    irq_event_runtime* rt_;
+    // Only accessed from the runtime
+    etl::optional<T> ready_;
+    std::coroutine_handle<> waiter_{};
+
+    static void run_event(poly::detail::irq_event_base& base)
+    {
+        auto& self = static_cast<irq_awaitable&>(base);
+        uint8_t state = poly::detail::irq_event_state::begin_run(self.state_);
+        if(state & writing_bit)
+        {
+            // The writer posts the event again when it is done
+            return;
+        }
+
+        if(state & has_data_bit)
+        {
+            self.ready_.emplace(etl::move(*self.data_));
+            self.data_.destroy();
+        }
+        poly::detail::irq_event_state::unlock(self.state_, has_data_bit);
+
+        if(self.ready_ && self.waiter_)
+        {
+            auto waiter = self.waiter_;
+            self.waiter_ = {};
+            waiter.resume();
+        }
+    }
+
+    struct awaiter
+    {
+        irq_awaitable& self;
+
+        bool await_ready() const noexcept
+        {
+            return self.ready_.has_value();
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) noexcept
+        {
+            assert(!self.waiter_);
+            self.waiter_ = handle;
+        }
+
+        T await_resume()
+        {
+            T value = etl::move(*self.ready_);
+            self.ready_.reset();
+            return value;
+        }
+    };
+public:
+    /**
+     * @brief Constructor for the awaitable.
+     * @param rt The runtime that resumes the waiting coroutine.
+     * @param priority The priority lane of the runtime to post to, 0 is the highest priority.
+     */
+    explicit irq_awaitable(irq_event_runtime& rt, uint8_t priority = 0)
+        : poly::detail::irq_event_base(run_event), rt_(&rt)
+    {
+        set_priority(priority);
+    }
+
+    irq_awaitable(const irq_awaitable&) = delete;
+    irq_awaitable& operator=(const irq_awaitable&) = delete;
+
+    ~irq_awaitable()
+    {
+        if(state_.load(etl::memory_order_relaxed) & has_data_bit)
+        {
+            data_.destroy();
+        }
+    }
+
+    /**
+     * @brief Try to set the data and post the event from IRQ context.
+     * @param baton IRQ baton.
+     * @param data The data for the waiting coroutine.
+     * @return true if the data was set, false if data is being written or taken at the same time.
+     */
+    bool try_post(irq_baton baton, T data)
+    {
+        uint8_t previous;
+        if(!poly::detail::irq_event_state::try_lock(state_, previous, has_data_bit | posted_bit))
+        {
+            return false;
+        }
+
+        if(previous & has_data_bit)
+        {
+            data_.destroy();
+        }
+        data_.emplace(etl::move(data));
+        if((previous & posted_bit) == 0)
+        {
+            // Not in a lane, nothing else changes the state until the event is posted below
+            state_.store(has_data_bit | posted_bit, etl::memory_order_release);
+            rt_->post(baton, *this);
+            return true;
+        }
+
+        // The runtime may have started the event while the data was written, it is then posted again.
+        uint8_t state = poly::detail::irq_event_state::release(state_, 0xFF, has_data_bit | posted_bit);
+        if((state & posted_bit) == 0)
+        {
+            rt_->post(baton, *this);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Wait for data posted from IRQ context.
+     */
+    awaiter operator co_await() noexcept
+    {
+        return awaiter{*this};
+    }
+};
+
+/**
+ * @brief Void specialization of irq_awaitable, a signal from an interrupt to a coroutine.
+ */
+template<>
+class irq_awaitable<void> final: public poly::detail::irq_event_base
+{
+    etl::atomic<uint8_t> state_{0};
+    // Only accessed from the runtime
+    bool ready_ = false;
+    irq_event_runtime* rt_;
+    std::coroutine_handle<> waiter_{};
+
+    static void run_event(poly::detail::irq_event_base& base)
+    {
+        auto& self = static_cast<irq_awaitable&>(base);
+        self.state_.store(0, etl::memory_order_release);
+        self.ready_ = true;
+
+        if(self.waiter_)
+        {
+            auto waiter = self.waiter_;
+            self.waiter_ = {};
+            waiter.resume();
+        }
+    }
+
+    struct awaiter
+    {
+        irq_awaitable& self;
+
+        bool await_ready() const noexcept
+        {
+            return self.ready_;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) noexcept
+        {
+            assert(!self.waiter_);
+            self.waiter_ = handle;
+        }
+
+        void await_resume() noexcept
+        {
+            self.ready_ = false;
+        }
+    };
+public:
+    /**
+     * @brief Constructor for the awaitable.
+     * @param rt The runtime that resumes the waiting coroutine.
+     * @param priority The priority lane of the runtime to post to, 0 is the highest priority.
+     */
+    explicit irq_awaitable(irq_event_runtime& rt, uint8_t priority = 0)
+        : poly::detail::irq_event_base(run_event), rt_(&rt)
+    {
+        set_priority(priority);
+    }
+
+    irq_awaitable(const irq_awaitable&) = delete;
+    irq_awaitable& operator=(const irq_awaitable&) = delete;
+
+    /**
+     * @brief Post the signal from IRQ context.
+     * @param baton IRQ baton.
+     */
+    void post(irq_baton baton)
+    {
+        if(poly::detail::irq_event_state::try_set_posted(state_))
+        {
+            rt_->post(baton, *this);
+        }
+    }
+
+    /**
+     * @brief Wait for the signal to be posted.
+     */
+    awaiter operator co_await() noexcept
+    {
+        return awaiter{*this};
+    }
+};
+}
@@ -0,0 +1,339 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#if !defined(__cpp_impl_coroutine) || !__has_include(<coroutine>)
+#error "poly/coro requires C++20 coroutine support"
+#endif
+
+#include "frame_pool.hpp"
+
+#include "poly/manual_lifetime.hpp"
+#include "poly/panic.hpp"
+
+#include <assert.h>
+#include <coroutine>
+#include <stddef.h>
+
+namespace poly::coro
+{
+template<class T = void>
+class task;
+
+namespace detail
+{
+/**
+ * @brief Common part of the promise of all tasks.
+ */
+class promise_base
+{
+    struct final_awaiter
+    {
+        bool await_ready() noexcept
+        {
+            return false;
+        }
+
+        template<class Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            promise_base& promise = handle.promise();
+            if(promise.detached_)
+            {
+                handle.destroy();
+                return std::noop_coroutine();
+            }
+            if(promise.continuation_)
+            {
+                return promise.continuation_;
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    template<class T>
+    friend class poly::coro::task;
+
+    std::coroutine_handle<> continuation_{};
+    bool detached_ = false;
+public:
+    static void* operator new(size_t size) noexcept
+    {
+        return allocate_frame(size);
+    }
+
+    static void operator delete(void* frame)
+    {
+        deallocate_frame(frame);
+    }
+
+    std::suspend_always initial_suspend() noexcept
+    {
+        return {};
+    }
+
+    final_awaiter final_suspend() noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception()
+    {
+        poly::panic();
+    }
+};
+
+template<class T>
+class promise: public promise_base
+{
+    manual_lifetime<T> value_;
+    bool has_value_ = false;
+public:
+    promise() = default;
+    promise(const promise&) = delete;
+    promise& operator=(const promise&) = delete;
+
+    ~promise()
+    {
+        if(has_value_)
+        {
+            value_.destroy();
+        }
+    }
+
+    task<T> get_return_object() noexcept;
+    static task<T> get_return_object_on_allocation_failure() noexcept;
+
+    template<class U>
+    void return_value(U&& value)
+    {
+        value_.emplace(static_cast<U&&>(value));
+        has_value_ = true;
+    }
+
+    T take_value()
+    {
+        return static_cast<T&&>(*value_);
+    }
+};
+
+template<>
+class promise<void>: public promise_base
+{
+public:
+    task<void> get_return_object() noexcept;
+    static task<void> get_return_object_on_allocation_failure() noexcept;
+
+    void return_void() noexcept {}
+    void take_value() noexcept {}
+};
+}
+
+/**
+ * @brief A lazily started coroutine returning a `T`.
+ * @tparam T The result of the coroutine.
+ *
+ * The task does not start until it is awaited by another task, or started with `start` or `detach`. Frames
+ * are allocated with the allocator set by `set_frame_allocator`, so no heap is used. When no frame can be
+ * allocated the task is empty, see `valid`.
+ *
+ * Tasks are resumed from the context that completes whatever they await, normally the runtime running
+ * `irq_event_runtime::run_available`.
+ */
+template<class T>
+class task
+{
+public:
+    using promise_type = detail::promise<T>;
+private:
+    std::coroutine_handle<promise_type> handle_{};
+    bool started_ = false;
+
+    friend promise_type;
+
+    explicit task(std::coroutine_handle<promise_type> handle): handle_(handle) {}
+
+    struct awaiter
+    {
+        std::coroutine_handle<promise_type> handle;
+        // The task was started before it was awaited, it is suspended in its own awaits
+        bool started;
+
+        bool await_ready() noexcept
+        {
+            return !handle || handle.done();
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            // A task can only resume one awaiting coroutine when it completes
+            assert(!handle.promise().continuation_);
+            handle.promise().continuation_ = awaiting;
+            if(started)
+            {
+                // Resumed by whatever the task awaits, the awaiting coroutine is resumed when it completes
+                return std::noop_coroutine();
+            }
+            return handle;
+        }
+
+        T await_resume()
+        {
+            if(!handle)
+            {
+                poly::panic();
+            }
+            return handle.promise().take_value();
+        }
+    };
+public:
+    task() = default;
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+
+    task(task&& other) noexcept: handle_(other.handle_), started_(other.started_)
+    {
+        other.handle_ = {};
+    }
+
+    task& operator=(task&& other) noexcept
+    {
+        if(this != &other)
+        {
+            reset();
+            handle_ = other.handle_;
+            started_ = other.started_;
+            other.handle_ = {};
+        }
+        return *this;
+    }
+
+    ~task()
+    {
+        reset();
+    }
+
+    /**
+     * @brief Check if the task has a coroutine frame, false if the frame could not be allocated.
+     */
+    [[nodiscard]] bool valid() const
+    {
+        return static_cast<bool>(handle_);
+    }
+
+    /**
+     * @brief Check if the coroutine has run to completion.
+     */
+    [[nodiscard]] bool done() const
+    {
+        return handle_ && handle_.done();
+    }
+
+    /**
+     * @brief Start running the coroutine until its first suspension point, if it has not started.
+     */
+    void start()
+    {
+        if(handle_ && !started_)
+        {
+            started_ = true;
+            handle_.resume();
+        }
+    }
+
+    /**
+     * @brief Start the coroutine and let it free its frame when it completes.
+     *
+     * The task is empty afterwards.
+     */
+    void detach()
+    {
+        if(!handle_)
+        {
+            return;
+        }
+
+        auto handle = handle_;
+        handle_ = {};
+        if(handle.done())
+        {
+            handle.destroy();
+            return;
+        }
+        handle.promise().detached_ = true;
+        if(!started_)
+        {
+            handle.resume();
+        }
+    }
+
+    /**
+     * @brief Await the result of the task from another task.
+     *
+     * A task that was already started with `start` is not resumed again, the awaiting task is resumed when it
+     * completes. A task may only be awaited by one task at a time.
+     */
+    awaiter operator co_await() && noexcept
+    {
+        bool started = started_;
+        started_ = true;
+        return awaiter{handle_, started};
+    }
+private:
+    void reset()
+    {
+        if(handle_)
+        {
+            handle_.destroy();
+            handle_ = {};
+        }
+    }
+};
+
+namespace detail
+{
+template<class T>
+task<T> promise<T>::get_return_object() noexcept
+{
+    return task<T>(std::coroutine_handle<promise<T>>::from_promise(*this));
+}
+
+template<class T>
+task<T> promise<T>::get_return_object_on_allocation_failure() noexcept
+{
+    return task<T>();
+}
+
+inline task<void> promise<void>::get_return_object() noexcept
+{
+    return task<void>(std::coroutine_handle<promise<void>>::from_promise(*this));
+}
+
+inline task<void> promise<void>::get_return_object_on_allocation_failure() noexcept
+{
+    return task<void>();
+}
+}
+}
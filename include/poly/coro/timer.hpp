@@ -0,0 +1,70 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#if !defined(__cpp_impl_coroutine) || !__has_include(<coroutine>)
+#error "poly/coro requires C++20 coroutine support"
+#endif
+
+#include "poly/timer.hpp"
+
+#include <coroutine>
+
+namespace poly::coro
+{
+/**
+ * @brief Awaiter returned by `wait`, resumes the coroutine when the timer expires.
+ */
+class timer_awaiter
+{
+    deadline_timer& timer_;
+    deadline_timer::duration timeout_;
+public:
+    timer_awaiter(deadline_timer& timer, deadline_timer::duration timeout): timer_(timer), timeout_(timeout) {}
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        timer_.async_wait([handle](deadline_timer&) { handle.resume(); }, timeout_);
+    }
+
+    void await_resume() const noexcept {}
+};
+
+/**
+ * @brief Suspend the coroutine until `timeout` has elapsed, `co_await poly::coro::wait(timer, 100_ms)`.
+ * @param timer The timer used for the wait, replaces any handler it has.
+ * @param timeout The time to wait.
+ *
+ * The coroutine is resumed from the runtime driving the timer task. Cancelling the timer while waiting leaves
+ * the coroutine suspended.
+ */
+inline timer_awaiter wait(deadline_timer& timer, deadline_timer::duration timeout)
+{
+    return timer_awaiter(timer, timeout);
+}
+}
@@ -21,21 +21,65 @@
 
 #pragma once
 
+#include "etl/atomic.h"
+
+#include <stdint.h>
+
 namespace poly
 {
 class irq_event_runtime;
+class irq_event_group;
 namespace detail
 {
+class irq_event_stack_lane;
+class irq_event_mpsc_lane;
+class irq_event_list;
 class irq_event_base
 {
     friend class poly::irq_event_runtime;
+    friend class poly::irq_event_group;
+    friend class irq_event_stack_lane;
+    friend class irq_event_mpsc_lane;
+    friend class irq_event_list;
     // next_ pointer is used by the runtime to
     // form a linked list of events that are ready to
-    // run.
-    irq_event_base* next_ = nullptr;
+    // run. It is atomic since some lanes link events while
+    // the consumer is reading the list.
+    etl::atomic<irq_event_base*> next_{nullptr};
+    // Trampoline to the derived event, this replaces a virtual function so that
+    // running an event is a single indirect call and events don't need a vtable.
+    void (*run_)(irq_event_base&);
+    // The runtime lane this event is posted to, 0 is the highest priority.
+    uint8_t priority_ = 0;
+protected:
+    /**
+     * @brief Constructor.
+     * @param run Function called with this event when it is run by the runtime.
+     */
+    explicit irq_event_base(void (*run)(irq_event_base&)): run_(run) {}
+    ~irq_event_base() = default;
+
+    void set_priority(uint8_t priority) {
+        priority_ = priority;
+    }
 public:
-    virtual ~irq_event_base() = default;
-    virtual void run_callback() = 0;
+    irq_event_base(const irq_event_base&) = delete;
+    irq_event_base& operator=(const irq_event_base&) = delete;
+
+    /**
+     * @brief Runs the callback of the event. This should not be called from user code.
+     */
+    void run_callback() {
+        run_(*this);
+    }
+
+    /**
+     * @brief Get the priority of this event.
+     * @return The runtime priority lane of this event, 0 being the highest priority.
+     */
+    [[nodiscard]] uint8_t priority() const {
+        return priority_;
+    }
 };
 }
 }
\ No newline at end of file
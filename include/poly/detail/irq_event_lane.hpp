@@ -0,0 +1,43 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "poly/config.hpp"
+
+#ifdef POLY_CONFIG_IRQ_EVENT_MPSC_QUEUE
+#include "irq_event_mpsc_lane.hpp"
+#else
+#include "irq_event_stack_lane.hpp"
+#endif
+
+namespace poly::detail
+{
+/**
+ * @brief The lane type used by `irq_event_runtime`.
+ */
+#ifdef POLY_CONFIG_IRQ_EVENT_MPSC_QUEUE
+using irq_event_lane = irq_event_mpsc_lane;
+#else
+using irq_event_lane = irq_event_stack_lane;
+#endif
+}
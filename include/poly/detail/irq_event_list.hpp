@@ -0,0 +1,90 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "irq_event_base.hpp"
+
+#include "etl/atomic.h"
+
+namespace poly::detail
+{
+/**
+ * @brief A plain FIFO list of events, linked through `irq_event_base::next_`.
+ *
+ * The list is not thread-safe, it is meant for events that have already been taken from a lane.
+ */
+class irq_event_list
+{
+    irq_event_base* head_ = nullptr;
+    irq_event_base* tail_ = nullptr;
+public:
+    irq_event_list() = default;
+    irq_event_list(const irq_event_list&) = delete;
+    irq_event_list& operator=(const irq_event_list&) = delete;
+
+    /**
+     * @brief Add an event to the back of the list.
+     * @param evt The event to add.
+     */
+    void push_back(irq_event_base& evt)
+    {
+        evt.next_.store(nullptr, etl::memory_order_relaxed);
+        if(tail_ != nullptr)
+        {
+            tail_->next_.store(&evt, etl::memory_order_relaxed);
+        }
+        else
+        {
+            head_ = &evt;
+        }
+        tail_ = &evt;
+    }
+
+    /**
+     * @brief Remove the event at the front of the list.
+     * @return The removed event or nullptr if the list is empty.
+     */
+    irq_event_base* pop_front()
+    {
+        irq_event_base* evt = head_;
+        if(evt != nullptr)
+        {
+            head_ = evt->next_.load(etl::memory_order_relaxed);
+            if(head_ == nullptr)
+            {
+                tail_ = nullptr;
+            }
+        }
+        return evt;
+    }
+
+    /**
+     * @brief Checks if the list is empty.
+     * @return True if the list is empty.
+     */
+    [[nodiscard]] bool empty() const
+    {
+        return head_ == nullptr;
+    }
+};
+}
@@ -0,0 +1,166 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "irq_event_base.hpp"
+
+#include "etl/atomic.h"
+
+namespace poly::detail
+{
+/**
+ * @brief A wait-free multi-producer single-consumer queue of pending events in an `irq_event_runtime`.
+ *
+ * This is an intrusive version of Dmitry Vyukov's MPSC queue. Producers swap themselves in as the new
+ * head of the queue with a single exchange, and then link the previous head to themselves. The consumer
+ * pops from the tail, so events are kept in FIFO order and no reversal is needed when draining.
+ *
+ * The queue always contains a stub event, which is used to detect when the queue is empty.
+ *
+ * A producer that is preempted between the exchange and the link temporarily hides all events
+ * posted after it from the consumer. `pop()` returns nullptr in this state even though `empty()` is false.
+ */
+class irq_event_mpsc_lane
+{
+    struct stub_event final: irq_event_base
+    {
+        stub_event(): irq_event_base([](irq_event_base&) {}) {}
+    };
+
+    etl::atomic<irq_event_base*> head_;
+    // Oldest event in the queue. Only written by the consumer, atomic so that `empty()`
+    // may be called from other contexts. Mutable since etl::atomic::load is not const.
+    mutable etl::atomic<irq_event_base*> tail_;
+    // Mutable since etl::atomic::load is not const.
+    mutable stub_event stub_;
+
+    /**
+     * @brief Push a chain of events to the head of the queue.
+     * @param first The first event of the chain.
+     * @param last The last event of the chain.
+     * @return The previous head of the queue.
+     */
+    irq_event_base* push_head(irq_event_base& first, irq_event_base& last)
+    {
+        last.next_.store(nullptr, etl::memory_order_relaxed);
+        irq_event_base* prev = head_.exchange(&last, etl::memory_order_acq_rel);
+        // Between the exchange and this store the queue is disconnected,
+        // see the class documentation.
+        if(prev == &stub_)
+        {
+            // The lane was empty. Sequentially consistent so that a consumer that releases
+            // ownership and then checks `empty()` either sees this link or is seen by the
+            // wakeup that follows this push.
+            stub_.next_.store(&first);
+        }
+        else
+        {
+            prev->next_.store(&first, etl::memory_order_release);
+        }
+        return prev;
+    }
+public:
+    irq_event_mpsc_lane(): head_(&stub_), tail_(&stub_) {}
+    irq_event_mpsc_lane(const irq_event_mpsc_lane&) = delete;
+    irq_event_mpsc_lane& operator=(const irq_event_mpsc_lane&) = delete;
+
+    /**
+     * @brief Push an event to the lane.
+     * @param evt The event to push.
+     * @return True if the lane was empty before the push.
+     */
+    bool push(irq_event_base& evt)
+    {
+        // The stub is only the head when the consumer has popped every event.
+        return push_head(evt, evt) == &stub_;
+    }
+
+    /**
+     * @brief Push a chain of events, linked from `first` to `last`, to the lane.
+     * @param first The first event of the chain.
+     * @param last The last event of the chain.
+     * @return True if the lane was empty before the push.
+     */
+    bool push_chain(irq_event_base& first, irq_event_base& last)
+    {
+        return push_head(first, last) == &stub_;
+    }
+
+    /**
+     * @brief Pop the oldest event from the lane.
+     * @return The popped event or nullptr if the lane is empty, or if a producer is in the middle of a push.
+     */
+    irq_event_base* pop()
+    {
+        irq_event_base* tail = tail_.load(etl::memory_order_relaxed);
+        irq_event_base* next = tail->next_.load(etl::memory_order_acquire);
+        if(tail == &stub_)
+        {
+            if(next == nullptr)
+            {
+                return nullptr;
+            }
+            // Skip past the stub
+            tail_.store(next, etl::memory_order_relaxed);
+            tail = next;
+            next = next->next_.load(etl::memory_order_acquire);
+        }
+
+        if(next != nullptr)
+        {
+            tail_.store(next, etl::memory_order_relaxed);
+            return tail;
+        }
+
+        if(tail != head_.load(etl::memory_order_acquire))
+        {
+            // A producer has swapped in a new head but not yet linked it.
+            return nullptr;
+        }
+
+        // tail is the last event, put the stub back behind it so that it can be popped
+        // without leaving the queue without any event.
+        push_head(stub_, stub_);
+        next = tail->next_.load(etl::memory_order_acquire);
+        if(next != nullptr)
+        {
+            tail_.store(next, etl::memory_order_relaxed);
+            return tail;
+        }
+
+        // Another producer got in between, the stub is linked after its event.
+        return nullptr;
+    }
+
+    /**
+     * @brief Checks if the lane is empty.
+     * @return True if there are no events to pop.
+     *
+     * This only reads atomic state and may be called from any context, also while another context pops.
+     */
+    [[nodiscard]] bool empty() const
+    {
+        return tail_.load() == &stub_ && stub_.next_.load() == nullptr;
+    }
+};
+}
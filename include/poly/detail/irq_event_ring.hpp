@@ -0,0 +1,522 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#pragma once
+
+#include "etl/array.h"
+#include "etl/atomic.h"
+#include "etl/optional.h"
+#include "etl/span.h"
+#include "etl/utility.h"
+
+#include "poly/irq_event_overflow.hpp"
+#include "poly/manual_lifetime.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace poly::detail
+{
+/**
+ * @brief The outcome of pushing an item to an IRQ event ring.
+ */
+enum class irq_event_push_result
+{
+    /// The item was not stored.
+    rejected,
+    /// The item was stored in a free slot.
+    pushed,
+    /// The item was stored in place of an item that is no longer pending.
+    replaced,
+};
+
+/**
+ * @brief Slots of a ring where an item only exists while it is pending, so `T` needs no default constructor.
+ */
+template<class T, std::size_t Capacity>
+class irq_event_lifetime_slots
+{
+    etl::array<manual_lifetime<T>, Capacity> items_;
+public:
+    void store(std::size_t index, T&& data)
+    {
+        items_[index].emplace(etl::move(data));
+    }
+
+    void take(std::size_t index, etl::optional<T>& data)
+    {
+        data.emplace(etl::move(*items_[index]));
+        items_[index].destroy();
+    }
+};
+
+/**
+ * @brief Slots of a ring where every item is always constructed, so that pending items can be handed to the
+ * runtime in place as contiguous spans. `T` must be default constructible and move assignable.
+ */
+template<class T, std::size_t Capacity>
+class irq_event_array_slots
+{
+    etl::array<T, Capacity> items_;
+public:
+    void store(std::size_t index, T&& data)
+    {
+        items_[index] = etl::move(data);
+    }
+
+    void take(std::size_t index, etl::optional<T>& data)
+    {
+        data.emplace(etl::move(items_[index]));
+    }
+
+    etl::span<T> span(std::size_t first, std::size_t count)
+    {
+        return etl::span<T>(items_.data() + first, count);
+    }
+};
+
+/**
+ * @brief Ring of items for an IRQ event set with a single producer and the runtime as the consumer.
+ * @tparam Slots The item storage, `irq_event_array_slots` is needed to consume items as spans.
+ *
+ * Only the head and tail indices are stored besides the items. The indices run from 0 to 2 * Capacity so
+ * that a full ring can be told apart from an empty one.
+ */
+template<class T, std::size_t Capacity, class Slots = irq_event_lifetime_slots<T, Capacity>>
+class irq_event_spsc_ring
+{
+    static constexpr std::size_t index_range = 2 * Capacity;
+
+    etl::atomic<std::size_t> head_{0};
+    etl::atomic<std::size_t> tail_{0};
+    Slots items_;
+
+    static std::size_t slot(std::size_t index)
+    {
+        return index >= Capacity ? index - Capacity : index;
+    }
+
+    static std::size_t next(std::size_t index)
+    {
+        return index + 1 == index_range ? 0 : index + 1;
+    }
+
+    static std::size_t advance(std::size_t index, std::size_t n)
+    {
+        index += n;
+        return index >= index_range ? index - index_range : index;
+    }
+
+    static std::size_t distance(std::size_t from, std::size_t to)
+    {
+        return to >= from ? to - from : to + index_range - from;
+    }
+public:
+    irq_event_spsc_ring() = default;
+    irq_event_spsc_ring(const irq_event_spsc_ring&) = delete;
+    irq_event_spsc_ring& operator=(const irq_event_spsc_ring&) = delete;
+
+    ~irq_event_spsc_ring()
+    {
+        etl::optional<T> discarded;
+        while(pop(discarded))
+        {
+        }
+    }
+
+    irq_event_push_result push(T&& data, std::size_t& occupancy)
+    {
+        std::size_t tail = tail_.load(etl::memory_order_relaxed);
+        std::size_t head = head_.load(etl::memory_order_acquire);
+        if(distance(head, tail) == Capacity)
+        {
+            return irq_event_push_result::rejected;
+        }
+
+        items_.store(slot(tail), etl::move(data));
+        tail_.store(next(tail));
+        occupancy = distance(head, next(tail));
+        return irq_event_push_result::pushed;
+    }
+
+    bool pop(etl::optional<T>& data)
+    {
+        std::size_t head = head_.load(etl::memory_order_relaxed);
+        if(head == tail_.load())
+        {
+            return false;
+        }
+
+        items_.take(slot(head), data);
+        head_.store(next(head), etl::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Hand the items that are pending when this is called to `fn` in place.
+     * @param fn Called with contiguous spans of items, twice when the items wrap around the end of the ring.
+     *
+     * The items may be moved from by `fn`, their slots are reused once it returns.
+     */
+    template<class F>
+    void consume(F&& fn)
+    {
+        std::size_t head = head_.load(etl::memory_order_relaxed);
+        std::size_t tail = tail_.load();
+        while(head != tail)
+        {
+            std::size_t first = slot(head);
+            std::size_t count = distance(head, tail);
+            if(first + count > Capacity)
+            {
+                count = Capacity - first;
+            }
+
+            fn(items_.span(first, count));
+            head = advance(head, count);
+            head_.store(head, etl::memory_order_release);
+        }
+    }
+
+    /**
+     * @brief Get the number of pending items.
+     */
+    std::size_t size()
+    {
+        return distance(head_.load(etl::memory_order_acquire), tail_.load(etl::memory_order_acquire));
+    }
+};
+
+/**
+ * @brief Ring of items for an IRQ event set with any number of producers and the runtime as the consumer.
+ *
+ * @tparam Slots The item storage, `irq_event_array_slots` is needed to consume items as spans.
+ *
+ * Follows Vyukov's bounded queue, each slot has a sequence number telling whether it is free for or written
+ * by the producer at a position. Positions wrap at a multiple of `Capacity`, and the two states are encoded
+ * apart from the position so that they never coincide, which makes any capacity down to 1 work.
+ */
+template<class T, std::size_t Capacity, class Slots = irq_event_lifetime_slots<T, Capacity>>
+class irq_event_mpsc_ring
+{
+    static constexpr std::size_t position_range = (SIZE_MAX / 4 / Capacity) * Capacity;
+
+    etl::atomic<std::size_t> tail_{0};
+    // Only written by the runtime, producers read it to track the occupancy.
+    etl::atomic<std::size_t> head_{0};
+    // A slot is free for position `pos` when its sequence is `2 * pos` and holds an item when it is `2 * pos + 1`.
+    etl::array<etl::atomic<std::size_t>, Capacity> sequences_;
+    Slots items_;
+
+    static std::size_t advance(std::size_t pos, std::size_t n)
+    {
+        return pos >= position_range - n ? pos + n - position_range : pos + n;
+    }
+
+    static std::size_t free_for(std::size_t pos)
+    {
+        return pos * 2;
+    }
+
+    static std::size_t written_by(std::size_t pos)
+    {
+        return pos * 2 + 1;
+    }
+
+    static intptr_t signed_distance(std::size_t from, std::size_t to)
+    {
+        std::size_t diff = to >= from ? to - from : to + position_range - from;
+        return diff > position_range / 2 ? static_cast<intptr_t>(diff) - static_cast<intptr_t>(position_range)
+                                         : static_cast<intptr_t>(diff);
+    }
+public:
+    irq_event_mpsc_ring()
+    {
+        for(std::size_t i = 0; i < Capacity; i++)
+        {
+            sequences_[i].store(free_for(i), etl::memory_order_relaxed);
+        }
+    }
+    irq_event_mpsc_ring(const irq_event_mpsc_ring&) = delete;
+    irq_event_mpsc_ring& operator=(const irq_event_mpsc_ring&) = delete;
+
+    ~irq_event_mpsc_ring()
+    {
+        etl::optional<T> discarded;
+        while(pop(discarded))
+        {
+        }
+    }
+
+    irq_event_push_result push(T&& data, std::size_t& occupancy)
+    {
+        std::size_t pos = tail_.load(etl::memory_order_relaxed);
+        while(true)
+        {
+            std::size_t sequence = sequences_[pos % Capacity].load(etl::memory_order_acquire);
+            intptr_t diff = signed_distance(pos, sequence / 2);
+            if(sequence == free_for(pos))
+            {
+                if(tail_.compare_exchange_weak(pos, advance(pos, 1), etl::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if(diff < 0)
+            {
+                return irq_event_push_result::rejected;
+            }
+            else
+            {
+                pos = tail_.load(etl::memory_order_relaxed);
+            }
+        }
+
+        items_.store(pos % Capacity, etl::move(data));
+        sequences_[pos % Capacity].store(written_by(pos));
+
+        intptr_t pending = signed_distance(head_.load(etl::memory_order_relaxed), advance(pos, 1));
+        occupancy = pending > 0 ? static_cast<std::size_t>(pending) : 0;
+        return irq_event_push_result::pushed;
+    }
+
+    bool pop(etl::optional<T>& data)
+    {
+        std::size_t head = head_.load(etl::memory_order_relaxed);
+        std::size_t index = head % Capacity;
+        if(sequences_[index].load() != written_by(head))
+        {
+            return false;
+        }
+
+        items_.take(index, data);
+        sequences_[index].store(free_for(advance(head, Capacity)), etl::memory_order_release);
+        head_.store(advance(head, 1), etl::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Hand up to `Capacity` completely written items to `fn` in place.
+     * @param fn Called with contiguous spans of items, twice when the items wrap around the end of the ring.
+     *
+     * Items are handed out in position order up to the first slot that is still being written. The items may
+     * be moved from by `fn`, their slots are reused once it returns.
+     */
+    template<class F>
+    void consume(F&& fn)
+    {
+        std::size_t consumed = 0;
+        while(consumed < Capacity)
+        {
+            std::size_t head = head_.load(etl::memory_order_relaxed);
+            std::size_t first = head % Capacity;
+            std::size_t count = 0;
+            while(first + count < Capacity && consumed + count < Capacity &&
+                  sequences_[first + count].load() == written_by(advance(head, count)))
+            {
+                count++;
+            }
+            if(count == 0)
+            {
+                return;
+            }
+
+            fn(items_.span(first, count));
+            for(std::size_t i = 0; i < count; i++)
+            {
+                sequences_[first + i].store(free_for(advance(head, i + Capacity)), etl::memory_order_release);
+            }
+            head_.store(advance(head, count), etl::memory_order_relaxed);
+            consumed += count;
+        }
+    }
+};
+
+/**
+ * @brief Ring of items for an IRQ event set with a single producer that drops or overwrites pending items
+ * when the ring is full.
+ *
+ * Each slot has a state in addition to its data. The runtime and the producer take a pending item by moving
+ * its slot from full to busy, so an item is never dropped while the runtime is moving it out. A post that
+ * would need the slot the runtime is busy with is rejected instead.
+ */
+template<class T, std::size_t Capacity, irq_event_overflow Overflow>
+class irq_event_spsc_drop_ring
+{
+    static_assert(Overflow != irq_event_overflow::reject, "Use irq_event_spsc_ring to reject on overflow");
+
+    static constexpr std::size_t index_range = 2 * Capacity;
+    static constexpr uint8_t slot_empty = 0;
+    static constexpr uint8_t slot_full = 1;
+    static constexpr uint8_t slot_busy = 2;
+
+    etl::atomic<std::size_t> head_{0};
+    etl::atomic<std::size_t> tail_{0};
+    etl::array<etl::atomic<uint8_t>, Capacity> states_;
+    etl::array<manual_lifetime<T>, Capacity> items_;
+
+    static std::size_t slot(std::size_t index)
+    {
+        return index >= Capacity ? index - Capacity : index;
+    }
+
+    static std::size_t next(std::size_t index)
+    {
+        return index + 1 == index_range ? 0 : index + 1;
+    }
+
+    static std::size_t prev(std::size_t index)
+    {
+        return index == 0 ? index_range - 1 : index - 1;
+    }
+
+    static std::size_t distance(std::size_t from, std::size_t to)
+    {
+        return to >= from ? to - from : to + index_range - from;
+    }
+
+    bool try_take(std::size_t index)
+    {
+        uint8_t expected = slot_full;
+        return states_[slot(index)].compare_exchange_strong(expected, slot_busy);
+    }
+public:
+    irq_event_spsc_drop_ring()
+    {
+        for(auto& state: states_)
+        {
+            state.store(slot_empty, etl::memory_order_relaxed);
+        }
+    }
+    irq_event_spsc_drop_ring(const irq_event_spsc_drop_ring&) = delete;
+    irq_event_spsc_drop_ring& operator=(const irq_event_spsc_drop_ring&) = delete;
+
+    ~irq_event_spsc_drop_ring()
+    {
+        etl::optional<T> discarded;
+        while(pop(discarded))
+        {
+        }
+    }
+
+    irq_event_push_result push(T&& data, std::size_t& occupancy)
+    {
+        std::size_t tail = tail_.load(etl::memory_order_relaxed);
+        std::size_t head = head_.load();
+        while(distance(head, tail) == Capacity)
+        {
+            if constexpr(Overflow == irq_event_overflow::drop_oldest)
+            {
+                if(try_take(head))
+                {
+                    items_[slot(head)].destroy();
+                    states_[slot(head)].store(slot_empty, etl::memory_order_relaxed);
+                    head_.store(next(head));
+
+                    items_[slot(tail)].emplace(etl::move(data));
+                    states_[slot(tail)].store(slot_full, etl::memory_order_release);
+                    tail_.store(next(tail));
+                    occupancy = Capacity;
+                    return irq_event_push_result::replaced;
+                }
+            }
+            else
+            {
+                std::size_t newest = prev(tail);
+                if(try_take(newest))
+                {
+                    auto& item = items_[slot(newest)];
+                    item.destroy();
+                    item.emplace(etl::move(data));
+                    states_[slot(newest)].store(slot_full, etl::memory_order_release);
+                    occupancy = distance(head_.load(), tail);
+                    return irq_event_push_result::replaced;
+                }
+            }
+
+            // The runtime is taking the item, see if that made room
+            std::size_t current_head = head_.load();
+            if(current_head == head)
+            {
+                return irq_event_push_result::rejected;
+            }
+            head = current_head;
+        }
+
+        items_[slot(tail)].emplace(etl::move(data));
+        states_[slot(tail)].store(slot_full, etl::memory_order_release);
+        tail_.store(next(tail));
+        occupancy = distance(head, next(tail));
+        return irq_event_push_result::pushed;
+    }
+
+    bool pop(etl::optional<T>& data)
+    {
+        while(true)
+        {
+            std::size_t head = head_.load();
+            if(head == tail_.load())
+            {
+                return false;
+            }
+
+            if(!try_take(head))
+            {
+                // The producer is dropping or overwriting the item and posts the event again when done.
+                return false;
+            }
+            if(head_.load() != head)
+            {
+                // The item was dropped and the slot reused by a newer item before it could be taken
+                states_[slot(head)].store(slot_full, etl::memory_order_release);
+                continue;
+            }
+
+            auto& item = items_[slot(head)];
+            data.emplace(etl::move(*item));
+            item.destroy();
+            states_[slot(head)].store(slot_empty, etl::memory_order_release);
+            head_.store(next(head));
+            return true;
+        }
+    }
+};
+
+/**
+ * @brief Selects the ring used by an IRQ event set with a single producer.
+ */
+template<class T, std::size_t Capacity, irq_event_overflow Overflow>
+struct irq_event_default_ring
+{
+    using type = irq_event_spsc_drop_ring<T, Capacity, Overflow>;
+};
+
+template<class T, std::size_t Capacity>
+struct irq_event_default_ring<T, Capacity, irq_event_overflow::reject>
+{
+    using type = irq_event_spsc_ring<T, Capacity>;
+};
+
+template<class T, std::size_t Capacity, irq_event_overflow Overflow>
+using irq_event_default_ring_t = typename irq_event_default_ring<T, Capacity, Overflow>::type;
+}
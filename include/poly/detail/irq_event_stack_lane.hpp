@@ -0,0 +1,163 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "irq_event_base.hpp"
+
+#include "etl/atomic.h"
+
+namespace poly::detail
+{
+/**
+ * @brief A lock-free queue of pending events in an `irq_event_runtime`.
+ *
+ * Events are posted to an atomic single-linked list where new events are added to the front,
+ * which means we effectively have a FILO queue. When the consumer runs out of ready events the
+ * entire pending list is taken and reversed, so even though events are stored in First In Last Out
+ * order, they are popped in First In First Out order.
+ *
+ * Any context may push events, only a single context may pop events.
+ *
+ * The consumer publishes whether it still holds taken events in `has_ready_`, so that a push can tell
+ * whether the whole lane was empty and not just the pending list.
+ */
+class irq_event_stack_lane
+{
+    mutable etl::atomic<irq_event_base*> pending_events_{nullptr};
+    // Events taken from `pending_events_`, in FIFO order. Only touched by the consumer.
+    irq_event_base* ready_events_ = nullptr;
+    // True while `ready_events_` is not empty. Written by the consumer, read by anyone.
+    mutable etl::atomic<bool> has_ready_{false};
+
+    /**
+     * @brief Reverse a single-linked list by iterating over it building a new linked list
+     * @param list_head The old list head to reverse from
+     * @return The head of the reversed list
+     */
+    static irq_event_base* reverse_list(irq_event_base* list_head)
+    {
+        // We form a new list by taking all elements from the supplied list
+        // pushing them to the front of the "retval" list
+        irq_event_base* retval_head = nullptr;
+        while(list_head != nullptr)
+        {
+            auto* rest_of_list = list_head->next_.load(etl::memory_order_relaxed);
+            list_head->next_.store(retval_head, etl::memory_order_relaxed);
+            retval_head = list_head;
+            list_head = rest_of_list;
+        }
+
+        return retval_head;
+    }
+public:
+    irq_event_stack_lane() = default;
+    irq_event_stack_lane(const irq_event_stack_lane&) = delete;
+    irq_event_stack_lane& operator=(const irq_event_stack_lane&) = delete;
+
+    /**
+     * @brief Push an event to the lane.
+     * @param evt The event to push.
+     * @return True if the lane was empty before the push.
+     */
+    bool push(irq_event_base& evt)
+    {
+        // We want to add evt to the front of the linked list.
+        // so evt.next_ needs to point to the current head of the list.
+        irq_event_base* head = pending_events_.load(etl::memory_order_acquire);
+        do
+        {
+            evt.next_.store(head, etl::memory_order_relaxed);
+            // Try to update the list head to evt, this will only succeed
+            // if head is the same as what is currently stored in pending_events_.
+            // If it fails compare_exchange_strong will update head to contain
+            // the current value stored in pending_events_.
+        } while(!pending_events_.compare_exchange_strong(head, &evt));
+        // Both are sequentially consistent, so either this sees the consumer clear `has_ready_`,
+        // or the consumer sees this event when it checks `pending_events_` afterwards.
+        return head == nullptr && !has_ready_.load();
+    }
+
+    /**
+     * @brief Push a chain of events, linked from `first` to `last`, to the lane.
+     * @param first The first event of the chain.
+     * @param last The last event of the chain, its next_ pointer must be nullptr.
+     * @return True if the lane was empty before the push.
+     */
+    bool push_chain(irq_event_base& first, irq_event_base& last)
+    {
+        // The pending list is stored newest first, so the chain is reversed
+        // before it is added to the front of the list.
+        reverse_list(&first);
+        irq_event_base* head = pending_events_.load(etl::memory_order_acquire);
+        do
+        {
+            first.next_.store(head, etl::memory_order_relaxed);
+        } while(!pending_events_.compare_exchange_strong(head, &last));
+        return head == nullptr && !has_ready_.load();
+    }
+
+    /**
+     * @brief Pop the oldest event from the lane.
+     * @return The popped event or nullptr if the lane is empty.
+     */
+    irq_event_base* pop()
+    {
+        if(ready_events_ == nullptr)
+        {
+            // Higher priority lanes are polled before every event that is run,
+            // so avoid the read-modify-write when nothing is pending.
+            if(pending_events_.load(etl::memory_order_acquire) == nullptr)
+            {
+                return nullptr;
+            }
+            // "Take" the entire list of posted events and reverse it to get FIFO order.
+            auto* evt = reverse_list(pending_events_.exchange(nullptr));
+            ready_events_ = evt->next_.load(etl::memory_order_relaxed);
+            if(ready_events_ != nullptr)
+            {
+                has_ready_.store(true);
+            }
+            return evt;
+        }
+
+        auto* evt = ready_events_;
+        ready_events_ = evt->next_.load(etl::memory_order_relaxed);
+        if(ready_events_ == nullptr)
+        {
+            has_ready_.store(false);
+        }
+        return evt;
+    }
+
+    /**
+     * @brief Checks if the lane is empty.
+     * @return True if there are no events to pop.
+     *
+     * This only reads atomic state and may be called from any context, also while another context pops.
+     */
+    [[nodiscard]] bool empty() const
+    {
+        return !has_ready_.load() && pending_events_.load() == nullptr;
+    }
+};
+}
@@ -0,0 +1,181 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#pragma once
+
+#include "etl/atomic.h"
+
+#include <cstdint>
+
+namespace poly::detail
+{
+/**
+ * @brief Bits of the atomic state word of an IRQ event.
+ */
+namespace irq_event_state
+{
+/// The event is posted to a runtime or a group and has not started running.
+constexpr uint8_t posted_bit = 0x01;
+/// The posted event has been cancelled, the runtime skips it.
+constexpr uint8_t cancelled_bit = 0x02;
+/// The data of the event is being written or taken.
+constexpr uint8_t writing_bit = 0x04;
+/// The event holds data.
+constexpr uint8_t has_data_bit = 0x08;
+
+/**
+ * @brief Mark an event as posted.
+ * @return true if the event must be posted to the runtime, false if it already is posted. A cancelled event
+ * that has not run yet is revived instead of posted again.
+ */
+inline bool try_set_posted(etl::atomic<uint8_t>& state)
+{
+    uint8_t current = state.load(etl::memory_order_relaxed);
+    uint8_t desired;
+    do
+    {
+        if(current & posted_bit)
+        {
+            if((current & cancelled_bit) == 0)
+            {
+                return false;
+            }
+            desired = current & ~cancelled_bit;
+        }
+        else
+        {
+            desired = current | posted_bit;
+        }
+    } while(!state.compare_exchange_weak(current, desired));
+
+    return (current & posted_bit) == 0;
+}
+
+/**
+ * @brief Take the writing lock and set the bits in `set` with the same CAS.
+ * @param previous Set to the state before the lock was taken.
+ * @return true if the lock was taken, false if someone else is writing.
+ */
+inline bool try_lock(etl::atomic<uint8_t>& state, uint8_t& previous, uint8_t set)
+{
+    previous = state.load(etl::memory_order_relaxed);
+    do
+    {
+        if(previous & writing_bit)
+        {
+            return false;
+        }
+    } while(!state.compare_exchange_weak(previous, static_cast<uint8_t>(previous | writing_bit | set),
+                                         etl::memory_order_acquire, etl::memory_order_relaxed));
+    return true;
+}
+
+/**
+ * @brief Release the writing lock, keeping the bits in `keep` and setting the bits in `set`.
+ * @return The state before it was released.
+ */
+inline uint8_t release(etl::atomic<uint8_t>& state, uint8_t keep, uint8_t set)
+{
+    uint8_t current = state.load(etl::memory_order_relaxed);
+    while(!state.compare_exchange_weak(current, static_cast<uint8_t>((current & keep & ~writing_bit) | set),
+                                       etl::memory_order_release, etl::memory_order_relaxed))
+    {
+    }
+    return current;
+}
+
+/**
+ * @brief Release the writing lock taken together with the posted bit by a post that must add the event to the
+ * runtime.
+ * @return true if the event must be posted to the runtime, false if it was cancelled while the lock was held.
+ *
+ * The event is in no lane, so a cancel while the lock is held clears the posted and cancelled bits, and the
+ * next post adds the event to the runtime again.
+ */
+inline bool unlock_posted(etl::atomic<uint8_t>& state)
+{
+    uint8_t current = state.load(etl::memory_order_relaxed);
+    uint8_t desired;
+    do
+    {
+        desired = current & ~writing_bit;
+        if(current & cancelled_bit)
+        {
+            desired &= ~(posted_bit | cancelled_bit);
+        }
+    } while(!state.compare_exchange_weak(current, desired, etl::memory_order_release, etl::memory_order_relaxed));
+    return (current & cancelled_bit) == 0;
+}
+
+/**
+ * @brief Release the writing lock and clear the bits in `clear`.
+ *
+ * Cheaper than `release` since the old state is not returned, which lets the compiler use a single atomic
+ * and instead of a CAS loop.
+ */
+inline void unlock(etl::atomic<uint8_t>& state, uint8_t clear)
+{
+    state.fetch_and(static_cast<uint8_t>(~(writing_bit | clear)), etl::memory_order_release);
+}
+
+/**
+ * @brief Start running a posted event.
+ * @return The state before the event started running.
+ *
+ * Clears the posted and cancelled bits and takes the writing lock with a single CAS, unless the event was
+ * cancelled or its data is being written. The caller must release the lock if it was taken.
+ */
+inline uint8_t begin_run(etl::atomic<uint8_t>& state)
+{
+    uint8_t current = state.load(etl::memory_order_relaxed);
+    uint8_t desired;
+    do
+    {
+        desired = current & ~(posted_bit | cancelled_bit);
+        if((current & (writing_bit | cancelled_bit)) == 0)
+        {
+            desired |= writing_bit;
+        }
+    } while(!state.compare_exchange_weak(current, desired, etl::memory_order_acq_rel, etl::memory_order_relaxed));
+    return current;
+}
+
+/**
+ * @brief Cancel a posted event that has not started running.
+ * @return true if the event was cancelled.
+ */
+inline bool try_cancel(etl::atomic<uint8_t>& state)
+{
+    uint8_t current = state.load(etl::memory_order_relaxed);
+    do
+    {
+        if((current & posted_bit) == 0 || (current & cancelled_bit))
+        {
+            return false;
+        }
+    } while(!state.compare_exchange_weak(current, current | cancelled_bit));
+
+    return true;
+}
+}
+}
@@ -0,0 +1,318 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "../type_traits.hpp"
+
+#include "etl/binary.h"
+#include "etl/intrusive_links.h"
+#include "etl/optional.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace poly::detail
+{
+/**
+ * @brief A circular, doubly linked list of timers.
+ *
+ * Timers are linked through their `etl::bidirectional_link<0>`, the list owns a sentinel
+ * link so a timer can remove itself with `safe_unlink()` without knowing which list it is in.
+ */
+template<class Timer>
+class timer_list
+{
+    using link_type = etl::bidirectional_link<0>;
+    link_type head_;
+public:
+    timer_list() {
+        head_.etl_previous = &head_;
+        head_.etl_next = &head_;
+    }
+    timer_list(const timer_list&) = delete;
+    timer_list& operator=(const timer_list&) = delete;
+
+    /**
+     * @brief Check if the list is empty.
+     * @return true if there are no timers in the list.
+     */
+    [[nodiscard]] bool empty() const {
+        return head_.etl_next == &head_;
+    }
+
+    /**
+     * @brief Add a timer to the back of the list.
+     * @param timer The timer to add, it must not be linked into any other list.
+     */
+    void push_back(Timer& timer) {
+        link_type& link = timer;
+        link.etl_previous = head_.etl_previous;
+        link.etl_next = &head_;
+        head_.etl_previous->etl_next = &link;
+        head_.etl_previous = &link;
+    }
+
+    /**
+     * @brief Remove the timer at the front of the list.
+     * @return The removed timer or nullptr if the list is empty.
+     */
+    Timer* pop_front() {
+        if(empty()) {
+            return nullptr;
+        }
+        link_type* link = head_.etl_next;
+        link->unlink();
+        link->clear();
+        return static_cast<Timer*>(link);
+    }
+
+    /**
+     * @brief Call a function for each timer in the list.
+     * @param f The function to call, with the signature `void(const Timer&)`.
+     */
+    template<class F>
+    void for_each(F&& f) const {
+        for(const link_type* link = head_.etl_next; link != &head_; link = link->etl_next) {
+            f(static_cast<const Timer&>(*link));
+        }
+    }
+
+    /**
+     * @brief Move all timers from this list to the back of `rhs`.
+     * @param rhs The list to move all timers to.
+     */
+    void move_to_back_of(timer_list& rhs) {
+        if(empty()) {
+            return;
+        }
+        link_type* first = head_.etl_next;
+        link_type* last = head_.etl_previous;
+        first->etl_previous = rhs.head_.etl_previous;
+        rhs.head_.etl_previous->etl_next = first;
+        last->etl_next = &rhs.head_;
+        rhs.head_.etl_previous = last;
+        head_.etl_previous = &head_;
+        head_.etl_next = &head_;
+    }
+};
+
+/**
+ * @brief Pick the expiry in `[earliest, earliest + slack]` with the most trailing zero bits.
+ * @param earliest The earliest allowed expiry.
+ * @param slack How much later than `earliest` the timer may expire.
+ * @return The chosen expiry.
+ *
+ * Timers whose allowed ranges overlap tend to be rounded to the same expiry, so they expire in
+ * the same wake up. Larger slack rounds to a coarser boundary.
+ */
+inline uint64_t coalesce_expiry(uint64_t earliest, uint64_t slack)
+{
+    if(slack == 0 || earliest == 0) {
+        return earliest;
+    }
+    const uint64_t latest = earliest + slack;
+    // The highest bit in which earliest - 1 and latest differ is the coarsest alignment in the range.
+    uint64_t diff = (earliest - 1) ^ latest;
+    size_t bit = 0;
+    while((diff >>= 1) != 0) {
+        ++bit;
+    }
+    return latest & ~((uint64_t(1) << bit) - 1);
+}
+
+/**
+ * @brief A hierarchical timing wheel.
+ * @tparam Timer The timer type. It must derive from `etl::bidirectional_link<0>` and have a
+ *               `uint64_t get_expiry() const` returning its absolute expiry in ticks.
+ * @tparam Levels The number of wheel levels.
+ * @tparam SlotBits log2 of the number of slots per level, at most 6.
+ *
+ * Level `k` has a resolution of `2^(SlotBits*k)` ticks. A timer is placed on the level given by the
+ * highest bit group in which its expiry differs from the current time, so starting and cancelling a
+ * timer is O(1). When time reaches a slot on a higher level its timers cascade down to a lower level,
+ * which happens at most `Levels` times per timer. Timers further away than `2^(SlotBits*Levels)` ticks
+ * are kept in an overflow list that is revisited once per wheel revolution.
+ *
+ * Finding the next slot to process looks at one occupancy bitmap per level and never walks the timers.
+ * Cancelled timers may leave a stale bit behind, which is cleared when the slot is found empty.
+ *
+ * The wheel is not thread-safe.
+ */
+template<class Timer, size_t Levels = 4, size_t SlotBits = 5>
+class timer_wheel
+{
+    static_assert(poly::is_base_of_v<etl::bidirectional_link<0>, Timer>, "Timers must derive from etl::bidirectional_link<0>");
+    static_assert(Levels > 0 && SlotBits > 0 && SlotBits <= 6, "Invalid timer wheel geometry");
+    static_assert(Levels * SlotBits < 64, "Timer wheel range must fit in 64 bits");
+
+    static constexpr size_t slot_count = size_t(1) << SlotBits;
+    static constexpr uint64_t slot_mask = slot_count - 1;
+    static constexpr size_t range_bits = Levels * SlotBits;
+    using bitmap_type = poly::conditional_t<(SlotBits <= 5), uint32_t, uint64_t>;
+
+    struct slot_ref {
+        size_t level;
+        size_t index;
+        uint64_t time;
+    };
+
+    timer_list<Timer> slots_[Levels][slot_count];
+    bitmap_type occupied_[Levels] = {};
+    timer_list<Timer> overflow_;
+    uint64_t now_ = 0;
+
+    static constexpr size_t level_of(uint64_t diff) {
+        size_t level = 0;
+        while((diff >> (SlotBits * (level + 1))) != 0) {
+            ++level;
+        }
+        return level;
+    }
+
+    static bitmap_type bits_from(size_t first) {
+        return first < slot_count ? static_cast<bitmap_type>(~bitmap_type(0) << first) : bitmap_type(0);
+    }
+
+    etl::optional<slot_ref> earliest_slot() {
+        // A slot on a lower level always expires before any slot on a higher level.
+        for(size_t level = 0; level < Levels; ++level) {
+            const size_t shift = SlotBits * level;
+            const size_t current = static_cast<size_t>((now_ >> shift) & slot_mask);
+            // Timers on higher levels always differ from now in their own bit group.
+            const size_t first = level == 0 ? current : current + 1;
+            bitmap_type candidates = occupied_[level] & bits_from(first);
+            while(candidates != 0) {
+                const size_t index = etl::count_trailing_zeros(candidates);
+                if(!slots_[level][index].empty()) {
+                    const uint64_t above = ~((uint64_t(1) << (shift + SlotBits)) - 1);
+                    return slot_ref{level, index, (now_ & above) | (uint64_t(index) << shift)};
+                }
+                // Every timer in this slot has been cancelled.
+                occupied_[level] &= static_cast<bitmap_type>(~(bitmap_type(1) << index));
+                candidates &= static_cast<bitmap_type>(candidates - 1);
+            }
+        }
+        if(!overflow_.empty()) {
+            return slot_ref{Levels, 0, ((now_ >> range_bits) + 1) << range_bits};
+        }
+        return etl::nullopt;
+    }
+public:
+    timer_wheel() = default;
+    timer_wheel(const timer_wheel&) = delete;
+    timer_wheel& operator=(const timer_wheel&) = delete;
+
+    /**
+     * @brief The current time of the wheel in ticks.
+     */
+    [[nodiscard]] uint64_t now() const {
+        return now_;
+    }
+
+    /**
+     * @brief Insert a timer into the wheel.
+     * @param timer The timer to insert, it must not be linked into any other list.
+     *
+     * A timer whose expiry has already passed expires on the next call to `advance`.
+     * Use `timer.safe_unlink()` to cancel the timer.
+     */
+    void insert(Timer& timer) {
+        uint64_t expiry = timer.get_expiry();
+        if(expiry < now_) {
+            expiry = now_;
+        }
+        const uint64_t diff = expiry ^ now_;
+        if((diff >> range_bits) != 0) {
+            overflow_.push_back(timer);
+            return;
+        }
+        const size_t level = level_of(diff);
+        const size_t index = static_cast<size_t>((expiry >> (SlotBits * level)) & slot_mask);
+        slots_[level][index].push_back(timer);
+        occupied_[level] |= static_cast<bitmap_type>(bitmap_type(1) << index);
+    }
+
+    /**
+     * @brief Get the earliest expiry of all timers in the wheel.
+     * @return The expiry, or an empty optional if there are no timers.
+     *
+     * When the earliest timers have not yet cascaded down to the lowest level, the timers of
+     * that single slot are visited to find the exact expiry, so no early wake up is needed.
+     */
+    [[nodiscard]] etl::optional<uint64_t> next_expiry() {
+        auto slot = earliest_slot();
+        if(!slot) {
+            return etl::nullopt;
+        }
+        if(slot->level == 0) {
+            return slot->time;
+        }
+        const timer_list<Timer>& list = slot->level == Levels ? overflow_ : slots_[slot->level][slot->index];
+        uint64_t earliest = UINT64_MAX;
+        list.for_each([&earliest](const Timer& timer) {
+            if(timer.get_expiry() < earliest) {
+                earliest = timer.get_expiry();
+            }
+        });
+        return earliest < slot->time ? slot->time : earliest;
+    }
+
+    /**
+     * @brief Advance the wheel, expiring all timers up to and including `target`.
+     * @tparam F The expiry handler type, with the signature `void(Timer&)`.
+     * @param target The new current time.
+     * @param on_expired Called for each expired timer, after it has been removed from the wheel.
+     *
+     * The handler may insert and cancel timers.
+     */
+    template<class F>
+    void advance(uint64_t target, F&& on_expired) {
+        while(auto slot = earliest_slot()) {
+            if(slot->time > target) {
+                break;
+            }
+            now_ = slot->time;
+            timer_list<Timer> local;
+            if(slot->level == Levels) {
+                overflow_.move_to_back_of(local);
+            }
+            else {
+                slots_[slot->level][slot->index].move_to_back_of(local);
+                occupied_[slot->level] &= static_cast<bitmap_type>(~(bitmap_type(1) << slot->index));
+            }
+
+            while(Timer* timer = local.pop_front()) {
+                if(slot->level == 0) {
+                    on_expired(*timer);
+                }
+                else {
+                    insert(*timer);
+                }
+            }
+        }
+        if(target > now_) {
+            now_ = target;
+        }
+    }
+};
+}
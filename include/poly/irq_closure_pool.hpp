@@ -0,0 +1,125 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "alloc/slot_allocator.hpp"
+#include "detail/irq_event_base.hpp"
+#include "function.hpp"
+#include "irq_event_runtime.hpp"
+#include "result.hpp"
+#include "string_literal.hpp"
+#include "utility.hpp"
+
+#include <assert.h>
+#include <cstddef>
+
+namespace poly
+{
+/**
+ * @brief A fixed-capacity pool of events that run arbitrary callables.
+ * @tparam Capacity The number of callables that can be pending at the same time.
+ * @tparam FunctionCapacity The storage capacity for each callable, see `basic_function`.
+ *
+ * This makes it possible to post capturing lambdas to a runtime without a statically allocated
+ * `irq_event` for each kind of work. The callable is stored in a node taken from the pool, and the
+ * node is returned to the pool after the callable has run. Nothing is dynamically allocated.
+ *
+ * Nodes are taken from a single-producer queue, so only one context may post to a pool.
+ */
+template<std::size_t Capacity, std::size_t FunctionCapacity = 4 * sizeof(void*)>
+class irq_closure_pool
+{
+    struct closure_event final: detail::irq_event_base
+    {
+        basic_function<void(), FunctionCapacity> fn_;
+        irq_closure_pool* pool_ = nullptr;
+
+        closure_event(): detail::irq_event_base(run_event) {}
+
+        void bind(irq_closure_pool& pool, uint8_t priority)
+        {
+            pool_ = &pool;
+            set_priority(priority);
+        }
+    };
+
+    alloc::slot_allocator<closure_event, Capacity> nodes_;
+    irq_event_runtime* rt_ = nullptr;
+    uint8_t priority_ = 0;
+
+    static void run_event(detail::irq_event_base& base)
+    {
+        auto& self = static_cast<closure_event&>(base);
+        self.fn_();
+        // Destroy the captured state before the node is reused
+        self.fn_ = +[]() {};
+        bool deallocated = self.pool_->nodes_.try_deallocate(&self);
+        assert(deallocated);
+        (void)deallocated;
+    }
+public:
+    irq_closure_pool() = default;
+    irq_closure_pool(const irq_closure_pool&) = delete;
+    irq_closure_pool& operator=(const irq_closure_pool&) = delete;
+
+    /**
+     * @brief Constructor for the pool.
+     * @param rt The runtime to post callables to.
+     * @param priority The priority lane of the runtime to post callables to, 0 is the highest priority.
+     */
+    explicit irq_closure_pool(irq_event_runtime& rt, uint8_t priority = 0): rt_(&rt), priority_(priority) {}
+
+    /**
+     * @brief Late initialization when the pool is constructed with default constructor.
+     * @param rt The runtime to post callables to.
+     * @param priority The priority lane of the runtime to post callables to, 0 is the highest priority.
+     */
+    void late_init(irq_event_runtime& rt, uint8_t priority = 0)
+    {
+        rt_ = &rt;
+        priority_ = priority;
+    }
+
+    /**
+     * @brief Post a callable to the runtime.
+     * @param baton IRQ baton.
+     * @param fn The callable, it must be invocable as `void()`.
+     * @return An error if the pool is exhausted.
+     */
+    template<class F>
+    poly::result<void, string_literal> post(irq_baton baton, F&& fn)
+    {
+        assert(rt_ != nullptr);
+
+        closure_event* node = nodes_.try_allocate();
+        if(node == nullptr)
+        {
+            return poly::error("Closure pool exhausted"_str);
+        }
+        node->fn_ = poly::forward<F>(fn);
+        node->bind(*this, priority_);
+        rt_->post(baton, *node);
+        return poly::ok();
+    }
+};
+}
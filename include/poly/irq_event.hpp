@@ -25,50 +25,102 @@
 #include "etl/optional.h"
 
 #include "detail/irq_event_base.hpp"
+#include "detail/irq_event_state.hpp"
+#include "irq_event_group.hpp"
 #include "irq_event_runtime.hpp"
+#include "manual_lifetime.hpp"
 
 #include <assert.h>
+#include <cstdint>
 
 namespace poly
 {
 /**
  * @brief A holder for an interrupt event. IRQ events are posted to a runtime for further handling.
  * @tparam Data The data stored by this IRQ event.
+ *
+ * The posted and cancelled flags, a writing lock and whether data is stored are kept in a single atomic state
+ * word, so the runtime clears the posted flag and takes the data with one CAS.
+ *
+ * A posted event can be cancelled with `try_cancel`, the runtime then skips it without calling the callback.
+ * Each cancel increments the generation of the event, which callbacks can compare against a generation
+ * stored in the data when it was posted to detect stale data.
  */
 template<class Data>
 class irq_event final: public detail::irq_event_base
 {
-    etl::optional<Data> data_;
-    etl::atomic<bool> lock_{};
-    etl::atomic<bool> is_posted_{};
+    static constexpr uint8_t posted_bit = detail::irq_event_state::posted_bit;
+    static constexpr uint8_t cancelled_bit = detail::irq_event_state::cancelled_bit;
+    static constexpr uint8_t writing_bit = detail::irq_event_state::writing_bit;
+    static constexpr uint8_t has_data_bit = detail::irq_event_state::has_data_bit;
+
+    // The state, the generation and the data are declared first so that they can be packed into the tail
+    // padding of the base.
+    etl::atomic<uint8_t> state_{0};
+    // Mutable since etl::atomic::load is not const.
+    mutable etl::atomic<uint16_t> generation_{0};
+    manual_lifetime<Data> data_;
     void (*cb_)(etl::optional<Data>) = nullptr;
     irq_event_runtime *rt_ = nullptr;
 
-    etl::optional<Data> try_take_data()
+    static void run_event(detail::irq_event_base& base)
     {
-        bool expected = false;
-        if(lock_.compare_exchange_strong(expected, true))
+        auto& self = static_cast<irq_event&>(base);
+
+        uint8_t state = detail::irq_event_state::begin_run(self.state_);
+        if(state & cancelled_bit)
+        {
+            return;
+        }
+        if(state & writing_bit)
+        {
+            // The writer posts the event again when it is done
+            self.cb_(etl::nullopt);
+            return;
+        }
+
+        etl::optional<Data> data;
+        if(state & has_data_bit)
         {
-            etl::optional<Data> retval = etl::move(data_);
-            data_ = etl::optional<Data>{};
-            lock_.store(false, etl::memory_order_release);
-            return retval;
+            data.emplace(etl::move(*self.data_));
+            self.data_.destroy();
         }
+        detail::irq_event_state::unlock(self.state_, has_data_bit);
+        self.cb_(etl::move(data));
+    }
 
-        return etl::nullopt;
+    void store_data(uint8_t previous, Data&& data)
+    {
+        if(previous & has_data_bit)
+        {
+            data_.destroy();
+        }
+        data_.emplace(etl::move(data));
     }
 
 public:
-    irq_event() = default;
+    irq_event(): detail::irq_event_base(run_event) {}
     /**
      * @brief Constructor for the event.
      * @param rt The runtime associated with this event.
      * @param callback The callback associated with this event. The callback will be called from the runtime.
+     * @param priority The priority lane of the runtime to post this event to, 0 is the highest priority.
      */
-    irq_event(irq_event_runtime& rt, void (*callback)(etl::optional<Data>)): cb_(callback), rt_(&rt)
+    irq_event(irq_event_runtime& rt, void (*callback)(etl::optional<Data>), uint8_t priority = 0)
+        : detail::irq_event_base(run_event), cb_(callback), rt_(&rt)
+    {
+        set_priority(priority);
+    }
+
+    irq_event(const irq_event&) = delete;
+    irq_event& operator=(const irq_event&) = delete;
+
+    ~irq_event()
     {
-        lock_.store(false, etl::memory_order_release);
-        is_posted_.store(false, etl::memory_order_release);
+        if(state_.load(etl::memory_order_relaxed) & has_data_bit)
+        {
+            data_.destroy();
+        }
     }
 
     /**
@@ -76,13 +128,18 @@ public:
      * 
      * @param rt The runtime associated with this event.
      * @param callback The callback associated with this event. The callback will be called from the runtime.
+     * @param priority The priority lane of the runtime to post this event to, 0 is the highest priority.
      */
-    void late_init(irq_event_runtime& rt, void (*callback)(etl::optional<Data>))
+    void late_init(irq_event_runtime& rt, void (*callback)(etl::optional<Data>), uint8_t priority = 0)
     {
+        set_priority(priority);
         cb_ = callback;
         rt_ = &rt;
-        lock_.store(false, etl::memory_order_release);
-        is_posted_.store(false, etl::memory_order_release);
+        if(state_.load(etl::memory_order_relaxed) & has_data_bit)
+        {
+            data_.destroy();
+        }
+        state_.store(0, etl::memory_order_release);
     }
 
     /**
@@ -91,14 +148,53 @@ public:
      * @return true if data was successfully set. Otherwise false.
      */
     bool try_set_data(irq_baton, Data data) {
-        bool expected = false;
-        if(lock_.compare_exchange_strong(expected, true))
+        uint8_t previous;
+        if(!detail::irq_event_state::try_lock(state_, previous, has_data_bit))
+        {
+            return false;
+        }
+
+        store_data(previous, etl::move(data));
+        detail::irq_event_state::unlock(state_, 0);
+        return true;
+    }
+
+    /**
+     * @brief Try to set the stored data and post the event to the associated runtime.
+     * @param baton IRQ baton.
+     * @param data The new data
+     * @return true if data was successfully set. Otherwise false and the event is not posted.
+     *
+     * Cheaper than `try_set_data` followed by `post`, the event is marked as posted with the same CAS that takes
+     * the writing lock. A `try_cancel` that succeeds while the data is written keeps the event from the runtime.
+     */
+    bool try_post(irq_baton baton, Data data) {
+        assert(rt_ != nullptr);
+
+        uint8_t previous;
+        if(!detail::irq_event_state::try_lock(state_, previous, has_data_bit | posted_bit))
         {
-            data_ = etl::move(data);
-            lock_.store(false, etl::memory_order_release);
+            return false;
+        }
+
+        store_data(previous, etl::move(data));
+        if((previous & posted_bit) == 0)
+        {
+            if(detail::irq_event_state::unlock_posted(state_))
+            {
+                rt_->post(baton, *this);
+            }
             return true;
         }
-        return false;
+
+        // The runtime may have started the event while the data was written, it is then posted again.
+        uint8_t state = detail::irq_event_state::release(state_, static_cast<uint8_t>(~cancelled_bit),
+                                                         has_data_bit | posted_bit);
+        if((state & posted_bit) == 0)
+        {
+            rt_->post(baton, *this);
+        }
+        return true;
     }
 
     /**
@@ -110,19 +206,51 @@ public:
     void post(irq_baton baton) {
         assert(rt_ != nullptr);
 
-        bool expected = false;
-        if(is_posted_.compare_exchange_strong(expected, true))
+        if(detail::irq_event_state::try_set_posted(state_))
         {
             rt_->post(baton, *this);
         }
     }
 
     /**
-     * @brief Runs the associated callback. This should not be called from user code.
+     * @brief Add the event to a group of events that are posted together.
+     * @param baton IRQ baton.
+     * @param group The group, see `irq_event_group`.
+     *
+     * The event is not posted to the runtime until the group is posted.
      */
-    void run_callback() override {
-        is_posted_.store(false, etl::memory_order_release);
-        cb_(try_take_data());
+    void post(irq_baton baton, irq_event_group& group) {
+        assert(rt_ != nullptr);
+
+        if(detail::irq_event_state::try_set_posted(state_))
+        {
+            group.add(baton, *rt_, *this);
+        }
+    }
+
+    /**
+     * @brief Cancel the event if it is posted and has not started running.
+     * @return true if the event was cancelled, the runtime skips it without calling the callback.
+     *
+     * The generation is incremented whether or not the cancel succeeds. A cancel fails when the runtime has
+     * already started the event, and the callback then runs with data that was set before the cancel. The
+     * increment lets the callback see that this data is stale, which is the case the generation exists for.
+     *
+     * Any data set on the event is kept and delivered with the next post. Posting a cancelled event before the
+     * runtime has skipped it revives it.
+     */
+    bool try_cancel()
+    {
+        generation_.fetch_add(1, etl::memory_order_relaxed);
+        return detail::irq_event_state::try_cancel(state_);
+    }
+
+    /**
+     * @brief Get the generation of the event, incremented by every call to `try_cancel`.
+     */
+    [[nodiscard]] uint16_t generation() const
+    {
+        return generation_.load(etl::memory_order_relaxed);
     }
 };
 
@@ -132,14 +260,28 @@ public:
 template<>
 class irq_event<void> final: public detail::irq_event_base
 {
+    // Declared first so that they can be packed into the tail padding of the base.
+    etl::atomic<uint8_t> state_{0};
+    // Mutable since etl::atomic::load is not const.
+    mutable etl::atomic<uint16_t> generation_{0};
     void (*cb_)() = nullptr;
     irq_event_runtime *rt_ = nullptr;
-    etl::atomic<bool> is_posted_{};
+
+    static void run_event(detail::irq_event_base& base)
+    {
+        auto& self = static_cast<irq_event&>(base);
+        uint8_t state = self.state_.exchange(0, etl::memory_order_acq_rel);
+        if((state & detail::irq_event_state::cancelled_bit) == 0)
+        {
+            self.cb_();
+        }
+    }
 public:
-    irq_event() = default;
-    irq_event(irq_event_runtime& rt, void (*callback)()): cb_(callback), rt_(&rt)
+    irq_event(): detail::irq_event_base(run_event) {}
+    irq_event(irq_event_runtime& rt, void (*callback)(), uint8_t priority = 0)
+        : detail::irq_event_base(run_event), cb_(callback), rt_(&rt)
     {
-        is_posted_.store(false, etl::memory_order_release);
+        set_priority(priority);
     }
 
     /**
@@ -147,12 +289,14 @@ public:
      *
      * @param rt The runtime associated with this event.
      * @param callback The callback associated with this event. The callback will be called from the runtime.
+     * @param priority The priority lane of the runtime to post this event to, 0 is the highest priority.
      */
-    void late_init(irq_event_runtime& rt, void (*callback)())
+    void late_init(irq_event_runtime& rt, void (*callback)(), uint8_t priority = 0)
     {
+        set_priority(priority);
         cb_ = callback;
         rt_ = &rt;
-        is_posted_.store(false, etl::memory_order_release);
+        state_.store(0, etl::memory_order_release);
     }
 
     /**
@@ -164,19 +308,50 @@ public:
     void post(irq_baton baton) {
         assert(rt_ != nullptr);
 
-        bool expected = false;
-        if(is_posted_.compare_exchange_strong(expected, true))
+        if(detail::irq_event_state::try_set_posted(state_))
         {
             rt_->post(baton, *this);
         }
     }
 
     /**
-     * @brief Runs the associated callback. This should not be called from user code.
+     * @brief Add the event to a group of events that are posted together.
+     * @param baton IRQ baton.
+     * @param group The group, see `irq_event_group`.
+     *
+     * The event is not posted to the runtime until the group is posted.
      */
-    void run_callback() override {
-        is_posted_.store(false, etl::memory_order_release);
-        cb_();
+    void post(irq_baton baton, irq_event_group& group) {
+        assert(rt_ != nullptr);
+
+        if(detail::irq_event_state::try_set_posted(state_))
+        {
+            group.add(baton, *rt_, *this);
+        }
+    }
+
+    /**
+     * @brief Cancel the event if it is posted and has not started running.
+     * @return true if the event was cancelled, the runtime skips it without calling the callback.
+     *
+     * The generation is incremented whether or not the cancel succeeds. A cancel fails when the runtime has
+     * already started the event, and the callback then runs anyway. A callback that compares the generation
+     * with the one recorded when the event was posted can tell that a cancel lost this race.
+     *
+     * Posting a cancelled event before the runtime has skipped it revives it.
+     */
+    bool try_cancel()
+    {
+        generation_.fetch_add(1, etl::memory_order_relaxed);
+        return detail::irq_event_state::try_cancel(state_);
+    }
+
+    /**
+     * @brief Get the generation of the event, incremented by every call to `try_cancel`.
+     */
+    [[nodiscard]] uint16_t generation() const
+    {
+        return generation_.load(etl::memory_order_relaxed);
     }
 };
 }
@@ -0,0 +1,129 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "etl/atomic.h"
+#include "etl/span.h"
+
+#include "detail/irq_event_base.hpp"
+#include "detail/irq_event_ring.hpp"
+#include "irq_event_runtime.hpp"
+#include "result.hpp"
+#include "string_literal.hpp"
+
+#include <assert.h>
+#include <cstddef>
+
+namespace poly
+{
+/**
+ * @brief An IRQ event set that delivers all pending items to one callback as a contiguous span.
+ * @tparam T The data stored for each item. Must be default constructible and move assignable.
+ * @tparam Capacity Number of items that can be pending.
+ *
+ * Items are stored in the same bounded ring as `irq_event_mpmc_set`, where each slot has a sequence number, so
+ * any number of contexts may post concurrently. A single event is posted to the runtime when the set goes from
+ * empty to pending, and the runtime calls the callback with every item that has been completely written since.
+ * The callback is called twice when the items wrap around the end of the ring. The items may be moved from in
+ * the callback, the slots are reused once the callback returns.
+ *
+ * This is a separate class from `irq_event_set` since the items are handed out in place. That needs every slot
+ * to hold a constructed `T` at all times, and a callback that takes a span instead of one item, while
+ * `irq_event_set` constructs an item only while it is pending and supports overflow policies. See
+ * `irq_event_queue` for the same delivery with a single producer.
+ */
+template<class T, std::size_t Capacity>
+class irq_event_batch_set final: public detail::irq_event_base
+{
+    static_assert(Capacity > 0, "irq_event_batch_set must have a capacity");
+
+    etl::atomic<bool> is_posted_{};
+    void (*cb_)(etl::span<T>) = nullptr;
+    irq_event_runtime *rt_ = nullptr;
+    detail::irq_event_mpsc_ring<T, Capacity, detail::irq_event_array_slots<T, Capacity>> ring_;
+
+    static void run_event(detail::irq_event_base& base)
+    {
+        auto& self = static_cast<irq_event_batch_set&>(base);
+        // Cleared before looking for items, a post after this posts the event again.
+        self.is_posted_.store(false);
+        self.ring_.consume(self.cb_);
+    }
+
+public:
+    irq_event_batch_set(): detail::irq_event_base(run_event) {}
+    irq_event_batch_set(const irq_event_batch_set&) = delete;
+    irq_event_batch_set& operator=(const irq_event_batch_set&) = delete;
+
+    /**
+     * @brief Constructor for the event set.
+     * @param rt The runtime associated with the set.
+     * @param callback The callback associated with the set. The callback will be called from the runtime.
+     * @param priority The priority lane of the runtime to post the set to, 0 is the highest priority.
+     */
+    irq_event_batch_set(irq_event_runtime& rt, void (*callback)(etl::span<T>), uint8_t priority = 0)
+        : detail::irq_event_base(run_event), cb_(callback), rt_(&rt)
+    {
+        set_priority(priority);
+    }
+
+    /**
+     * @brief Late initialization when event set is constructed with default constructor.
+     *
+     * @param rt The runtime associated with the set.
+     * @param callback The callback associated with the set. The callback will be called from the runtime.
+     * @param priority The priority lane of the runtime to post the set to, 0 is the highest priority.
+     */
+    void late_init(irq_event_runtime& rt, void (*callback)(etl::span<T>), uint8_t priority = 0)
+    {
+        set_priority(priority);
+        cb_ = callback;
+        rt_ = &rt;
+        is_posted_.store(false, etl::memory_order_release);
+    }
+
+    /**
+     * @brief Try to post an item to the event set.
+     * @param baton IRQ baton.
+     * @param data Item data.
+     * @return A result indicating if the post was successful or not.
+     */
+    poly::result<void, string_literal> post(irq_baton baton, T data)
+    {
+        assert(rt_ != nullptr);
+
+        std::size_t occupancy = 0;
+        if(ring_.push(etl::move(data), occupancy) == detail::irq_event_push_result::rejected)
+        {
+            return poly::error("Event set full"_str);
+        }
+
+        bool expected = false;
+        if(is_posted_.compare_exchange_strong(expected, true))
+        {
+            rt_->post(baton, *this);
+        }
+        return poly::ok();
+    }
+};
+}
@@ -0,0 +1,111 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "detail/irq_event_base.hpp"
+#include "irq_event_runtime.hpp"
+
+#include <assert.h>
+
+namespace poly
+{
+/**
+ * @brief Collects events that are posted together, typically at the end of an interrupt handler.
+ *
+ * Events are added to the group with `irq_event::post(irq_baton, irq_event_group&)`, which links them
+ * into a private chain. `post` then adds the whole chain to the runtime with a single atomic operation,
+ * instead of one per event. Events are run in the order they were added to the group.
+ *
+ * A chain can only hold events for a single runtime lane. If an event for another runtime or priority is
+ * added, the events collected so far are posted first.
+ *
+ * Any events that haven't been posted when the group is destroyed are posted by the destructor.
+ */
+class irq_event_group
+{
+    irq_event_runtime* rt_ = nullptr;
+    detail::irq_event_base* first_ = nullptr;
+    detail::irq_event_base* last_ = nullptr;
+public:
+    irq_event_group() = default;
+    irq_event_group(const irq_event_group&) = delete;
+    irq_event_group& operator=(const irq_event_group&) = delete;
+
+    ~irq_event_group()
+    {
+        post(irq_baton{});
+    }
+
+    /**
+     * @brief Add an event to the group. This should not be called by user code.
+     * @param baton IRQ baton.
+     * @param rt The runtime of the event.
+     * @param evt The event, it must already be marked as posted.
+     */
+    void add(irq_baton baton, irq_event_runtime& rt, detail::irq_event_base& evt)
+    {
+        if(first_ != nullptr && (rt_ != &rt || first_->priority() != evt.priority()))
+        {
+            post(baton);
+        }
+
+        evt.next_.store(nullptr, etl::memory_order_relaxed);
+        if(last_ != nullptr)
+        {
+            last_->next_.store(&evt, etl::memory_order_relaxed);
+        }
+        else
+        {
+            first_ = &evt;
+            rt_ = &rt;
+        }
+        last_ = &evt;
+    }
+
+    /**
+     * @brief Post all events in the group to the runtime.
+     * @param baton IRQ baton.
+     *
+     * The group is empty afterwards and can be reused.
+     */
+    void post(irq_baton baton)
+    {
+        if(first_ == nullptr)
+        {
+            return;
+        }
+        rt_->post_batch(baton, *first_, *last_);
+        first_ = nullptr;
+        last_ = nullptr;
+    }
+
+    /**
+     * @brief Checks if the group is empty.
+     * @return True if no events are waiting to be posted.
+     */
+    [[nodiscard]] bool empty() const
+    {
+        return first_ == nullptr;
+    }
+};
+}
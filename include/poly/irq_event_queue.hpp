@@ -0,0 +1,144 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "etl/atomic.h"
+#include "etl/span.h"
+
+#include "detail/irq_event_base.hpp"
+#include "detail/irq_event_ring.hpp"
+#include "irq_event_runtime.hpp"
+#include "result.hpp"
+#include "string_literal.hpp"
+
+#include <assert.h>
+#include <cstddef>
+
+namespace poly
+{
+/**
+ * @brief An IRQ event that queues its data instead of overwriting it.
+ * @tparam T The data stored in the queue. Must be default constructible and move assignable.
+ * @tparam Capacity Number of items that can be queued before the runtime handles them.
+ *
+ * Data is pushed from a single producer, usually an interrupt, into a lock-free ring. The event is posted to
+ * the runtime once when the ring becomes non-empty and the callback gets everything that has accumulated
+ * since, so no data is lost as long as the ring does not fill up.
+ *
+ * The callback is called with contiguous spans of the ring, so it is called twice when the queued items
+ * wrap around the end of the ring. The items may be moved from in the callback, the slots are reused once
+ * the callback returns. See `irq_event_batch_set` for the same delivery with several producers.
+ */
+template<class T, std::size_t Capacity>
+class irq_event_queue final: public detail::irq_event_base
+{
+    static_assert(Capacity > 0, "irq_event_queue must have a capacity");
+
+    etl::atomic<bool> is_posted_{};
+    void (*cb_)(etl::span<T>) = nullptr;
+    irq_event_runtime *rt_ = nullptr;
+    detail::irq_event_spsc_ring<T, Capacity, detail::irq_event_array_slots<T, Capacity>> ring_;
+
+    static void run_event(detail::irq_event_base& base)
+    {
+        auto& self = static_cast<irq_event_queue&>(base);
+        // Cleared before reading the tail, a push after this posts the event again.
+        self.is_posted_.store(false);
+        self.ring_.consume(self.cb_);
+    }
+
+public:
+    irq_event_queue(): detail::irq_event_base(run_event) {}
+    irq_event_queue(const irq_event_queue&) = delete;
+    irq_event_queue& operator=(const irq_event_queue&) = delete;
+
+    /**
+     * @brief Constructor for the event queue.
+     * @param rt The runtime associated with this event.
+     * @param callback The callback associated with this event. The callback will be called from the runtime.
+     * @param priority The priority lane of the runtime to post this event to, 0 is the highest priority.
+     */
+    irq_event_queue(irq_event_runtime& rt, void (*callback)(etl::span<T>), uint8_t priority = 0)
+        : detail::irq_event_base(run_event), cb_(callback), rt_(&rt)
+    {
+        set_priority(priority);
+    }
+
+    /**
+     * @brief Late initialization when event queue is constructed with default constructor.
+     *
+     * @param rt The runtime associated with this event.
+     * @param callback The callback associated with this event. The callback will be called from the runtime.
+     * @param priority The priority lane of the runtime to post this event to, 0 is the highest priority.
+     */
+    void late_init(irq_event_runtime& rt, void (*callback)(etl::span<T>), uint8_t priority = 0)
+    {
+        set_priority(priority);
+        cb_ = callback;
+        rt_ = &rt;
+        is_posted_.store(false, etl::memory_order_release);
+    }
+
+    /**
+     * @brief Queue data and post the event to the associated runtime if it is not already posted.
+     * @param baton IRQ baton.
+     * @param data Event data.
+     * @return A result indicating if the data was queued or not.
+     *
+     * Must only be called from one context at a time.
+     */
+    poly::result<void, string_literal> push(irq_baton baton, T data)
+    {
+        assert(rt_ != nullptr);
+
+        std::size_t occupancy = 0;
+        if(ring_.push(etl::move(data), occupancy) == detail::irq_event_push_result::rejected)
+        {
+            return poly::error("Event queue full"_str);
+        }
+
+        bool expected = false;
+        if(is_posted_.compare_exchange_strong(expected, true))
+        {
+            rt_->post(baton, *this);
+        }
+        return poly::ok();
+    }
+
+    /**
+     * @brief Get the number of queued items not yet handled by the runtime.
+     */
+    std::size_t size()
+    {
+        return ring_.size();
+    }
+
+    /**
+     * @brief Get the number of items that can be queued.
+     */
+    static constexpr std::size_t capacity()
+    {
+        return Capacity;
+    }
+};
+}
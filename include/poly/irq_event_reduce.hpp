@@ -0,0 +1,184 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "etl/atomic.h"
+
+#include "detail/irq_event_base.hpp"
+#include "irq_event_runtime.hpp"
+#include "limits.hpp"
+
+#include <assert.h>
+
+namespace poly
+{
+/**
+ * @brief Reducer for `irq_event_reduce` that combines values with bitwise or, e.g. for flags.
+ */
+struct reduce_or
+{
+    template<class T>
+    static constexpr T identity()
+    {
+        return T{};
+    }
+
+    template<class T>
+    static void fold(etl::atomic<T>& pending, T value)
+    {
+        pending.fetch_or(value);
+    }
+};
+
+/**
+ * @brief Reducer for `irq_event_reduce` that adds values together, e.g. for counters.
+ */
+struct reduce_add
+{
+    template<class T>
+    static constexpr T identity()
+    {
+        return T{};
+    }
+
+    template<class T>
+    static void fold(etl::atomic<T>& pending, T value)
+    {
+        pending.fetch_add(value);
+    }
+};
+
+/**
+ * @brief Reducer for `irq_event_reduce` that keeps the largest value.
+ */
+struct reduce_max
+{
+    template<class T>
+    static constexpr T identity()
+    {
+        return poly::numeric_limits<T>::min();
+    }
+
+    template<class T>
+    static void fold(etl::atomic<T>& pending, T value)
+    {
+        T current = pending.load(etl::memory_order_relaxed);
+        while(current < value && !pending.compare_exchange_weak(current, value))
+        {
+        }
+    }
+};
+
+/**
+ * @brief An IRQ event that folds the values posted to it into one pending value.
+ * @tparam T The value type, an integral type supported by `etl::atomic`.
+ * @tparam Reducer How values are combined, e.g. `reduce_or`, `reduce_add` or `reduce_max`.
+ *
+ * Posting folds the value into the pending value with an atomic read-modify-write and posts the event if it
+ * is not already posted. The runtime takes the combined value and resets it to the identity of the reducer,
+ * so posting many times before the runtime handles the event results in a single callback.
+ *
+ * A reducer has a static `identity<T>()` function returning the value that does not change the result and a
+ * static `fold(etl::atomic<T>&, T)` function combining a value into the pending value. The callback is not
+ * called when the pending value is the identity, since folding the identity changes nothing.
+ * Any number of contexts may post concurrently.
+ */
+template<class T, class Reducer>
+class irq_event_reduce final: public detail::irq_event_base
+{
+    etl::atomic<bool> is_posted_{};
+    void (*cb_)(T) = nullptr;
+    irq_event_runtime *rt_ = nullptr;
+    etl::atomic<T> pending_{Reducer::template identity<T>()};
+
+    static void run_event(detail::irq_event_base& base)
+    {
+        auto& self = static_cast<irq_event_reduce&>(base);
+        // Cleared before taking the value, a post after this posts the event again.
+        self.is_posted_.store(false);
+
+        T value = self.pending_.exchange(Reducer::template identity<T>());
+        if(value != Reducer::template identity<T>())
+        {
+            self.cb_(value);
+        }
+    }
+
+public:
+    irq_event_reduce(): detail::irq_event_base(run_event) {}
+    irq_event_reduce(const irq_event_reduce&) = delete;
+    irq_event_reduce& operator=(const irq_event_reduce&) = delete;
+
+    /**
+     * @brief Constructor for the event.
+     * @param rt The runtime associated with this event.
+     * @param callback The callback associated with this event. The callback will be called from the runtime.
+     * @param priority The priority lane of the runtime to post this event to, 0 is the highest priority.
+     */
+    irq_event_reduce(irq_event_runtime& rt, void (*callback)(T), uint8_t priority = 0)
+        : detail::irq_event_base(run_event), cb_(callback), rt_(&rt)
+    {
+        set_priority(priority);
+    }
+
+    /**
+     * @brief Late initialization when event is constructed with default constructor.
+     *
+     * @param rt The runtime associated with this event.
+     * @param callback The callback associated with this event. The callback will be called from the runtime.
+     * @param priority The priority lane of the runtime to post this event to, 0 is the highest priority.
+     */
+    void late_init(irq_event_runtime& rt, void (*callback)(T), uint8_t priority = 0)
+    {
+        set_priority(priority);
+        cb_ = callback;
+        rt_ = &rt;
+        pending_.store(Reducer::template identity<T>(), etl::memory_order_relaxed);
+        is_posted_.store(false, etl::memory_order_release);
+    }
+
+    /**
+     * @brief Fold a value into the pending value and post the event to the associated runtime.
+     * @param baton IRQ baton.
+     * @param value The value to fold into the pending value.
+     */
+    void post(irq_baton baton, T value)
+    {
+        assert(rt_ != nullptr);
+
+        Reducer::fold(pending_, value);
+
+        // A fold after the runtime took the pending value reads what the runtime left, so this also sees the
+        // flag that the runtime cleared before. An event that is already posted then needs no read-modify-write.
+        if(is_posted_.load(etl::memory_order_relaxed))
+        {
+            return;
+        }
+        bool expected = false;
+        if(is_posted_.compare_exchange_strong(expected, true))
+        {
+            rt_->post(baton, *this);
+        }
+    }
+};
+}
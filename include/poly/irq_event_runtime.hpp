@@ -22,14 +22,23 @@
 #pragma once
 
 #include "detail/irq_event_base.hpp"
+#include "detail/irq_event_lane.hpp"
 
-#include "etl/atomic.h"
+#include "etl/array.h"
 
+#include "chrono.hpp"
+#include "config.hpp"
+#include "platform/idle.hpp"
 #include "poly/result.hpp"
 #include "string_literal.hpp"
 
+#include <assert.h>
 #include <cstddef>
 
+#ifdef POLY_CONFIG_RUNTIME_TRACE
+#include "irq_event_trace.hpp"
+#endif
+
 namespace poly
 {
 struct irq_baton {};
@@ -37,84 +46,364 @@ struct irq_baton {};
 /**
  * @brief An event runtime to take post IRQ events for future handling to
  *
- * Events are added as a single-linked list where each event contains a pointer to the next
- * event. New events are always added to the front of the list, which means we effectively have
- * a FILO queue. The list is reversed before running the events, so even though events are stored
- * in First In Last Out order, they will be completed in First In First Out order.
+ * Events are posted to one of a number of priority lanes, selected by the priority of the event.
+ * Each lane is a single-linked list where each event contains a pointer to the next event,
+ * see `detail::irq_event_lane`. Events are completed in First In First Out order within a lane.
+ *
+ * A plain `irq_event_runtime` has a single lane, use `basic_irq_event_runtime` to get more lanes.
  */
 class irq_event_runtime
 {
-    mutable etl::atomic<detail::irq_event_base*> pending_events_{nullptr};
+    // Lane 0 is stored here so that a single lane runtime needs no extra storage,
+    // lanes 1 and up are provided by `basic_irq_event_runtime`.
+    detail::irq_event_lane first_lane_;
+    detail::irq_event_lane* other_lanes_ = nullptr;
+    std::size_t num_lanes_ = 1;
+    platform::idle::idle_signal idle_signal_;
+    void (*ready_hook_)(irq_event_runtime&) = nullptr;
+#ifdef POLY_CONFIG_RUNTIME_TRACE
+    irq_event_trace_hooks trace_hooks_{};
+
+    uint32_t trace_timestamp() const
+    {
+        return trace_hooks_.cycle_counter ? trace_hooks_.cycle_counter() : 0;
+    }
+#endif
+
+    detail::irq_event_lane& lane(std::size_t priority)
+    {
+        return priority == 0 ? first_lane_ : other_lanes_[priority - 1];
+    }
+
+    [[nodiscard]] const detail::irq_event_lane& lane(std::size_t priority) const
+    {
+        return priority == 0 ? first_lane_ : other_lanes_[priority - 1];
+    }
 
     /**
-     * @brief Reverse a single-linked list by iterating over it building a new linked list
-     * @param list_head The old list head to reverse from
-     * @return The head of the reversed list
+     * @brief Called when a lane goes from empty to non-empty.
      */
-    detail::irq_event_base* reverse_list(detail::irq_event_base* list_head)
+    void notify_ready()
     {
-        // We form a new list by taking all elements from the supplied list
-        // pushing them to the front of the "retval" list
-        detail::irq_event_base* retval_head = nullptr;
-        while(list_head != nullptr)
+        if(ready_hook_)
+        {
+            ready_hook_(*this);
+        }
+        else
         {
-            auto* rest_of_list = list_head->next_;
-            list_head->next_ = retval_head;
-            retval_head = list_head;
-            list_head = rest_of_list;
+            idle_signal_.notify();
         }
+    }
+protected:
+    /**
+     * @brief Constructor used by runtimes that provide more lanes.
+     * @param other_lanes Lanes 1 to `num_lanes - 1`, the first of these has the highest priority after lane 0.
+     * @param num_lanes The total number of lanes, including lane 0 of this class.
+     */
+    irq_event_runtime(detail::irq_event_lane* other_lanes, std::size_t num_lanes): other_lanes_(other_lanes), num_lanes_(num_lanes) {}
+
+    /**
+     * @brief Set a function to call instead of waking the idle signal when events become available.
+     * @param hook The function to call, or nullptr to use the idle signal.
+     *
+     * This is used by runtimes that run events from other contexts than the one calling the run functions.
+     */
+    void set_ready_hook(void (*hook)(irq_event_runtime&))
+    {
+        ready_hook_ = hook;
+    }
 
-        return retval_head;
+    /**
+     * @brief Run a single event.
+     * @param evt The event to run.
+     */
+    void run_event(detail::irq_event_base& evt)
+    {
+#ifdef POLY_CONFIG_RUNTIME_TRACE
+        if(trace_hooks_.on_run_begin)
+        {
+            trace_hooks_.on_run_begin(trace_hooks_.context, evt, trace_timestamp());
+        }
+        evt.run_callback();
+        if(trace_hooks_.on_run_end)
+        {
+            trace_hooks_.on_run_end(trace_hooks_.context, evt, trace_timestamp());
+        }
+#else
+        evt.run_callback();
+#endif
+    }
+
+    /**
+     * @brief Pop the oldest event of the highest priority non-empty lane.
+     * @return The popped event or nullptr if all lanes are empty.
+     */
+    detail::irq_event_base* pop_highest_priority()
+    {
+        for(std::size_t i = 0; i < num_lanes_; i++)
+        {
+            if(auto* evt = lane(i).pop())
+            {
+                return evt;
+            }
+        }
+        return nullptr;
     }
 public:
+    irq_event_runtime() = default;
+    irq_event_runtime(const irq_event_runtime&) = delete;
+    irq_event_runtime(irq_event_runtime&&) = delete;
+    irq_event_runtime& operator=(const irq_event_runtime&) = delete;
+    irq_event_runtime& operator=(irq_event_runtime&&) = delete;
+
     void post(irq_baton, detail::irq_event_base& evt)
     {
-        // We want to add evt to the front of the linked list.
-        // so evt.next_ needs to point to the current head of the list.
-        evt.next_ = pending_events_.load(etl::memory_order_acquire);
-        // Try to update the list head to evt, this will only succeed
-        // if evt.next_ is the same as what is currently stored in pending_events_.
-        while(!pending_events_.compare_exchange_strong(evt.next_, &evt))
+        assert(evt.priority() < num_lanes_);
+#ifdef POLY_CONFIG_RUNTIME_TRACE
+        if(trace_hooks_.on_post)
         {
-            // The compare exchange failed, compare_exchange_strong will update evt.next_ to contain
-            // the current value stored in pending_events_.
+            trace_hooks_.on_post(trace_hooks_.context, evt, trace_timestamp());
+        }
+#endif
+        // Only wake the consumer on an empty to non-empty transition,
+        // otherwise it is either already awake or has already been notified.
+        if(lane(evt.priority()).push(evt))
+        {
+            notify_ready();
+        }
+    }
+
+    /**
+     * @brief Post a chain of events with a single atomic operation.
+     * @param first The first event of the chain.
+     * @param last The last event of the chain.
+     *
+     * The chain is linked by `irq_event_group`, which should be used instead of calling this directly.
+     * All events in the chain must have the same priority. The events are run in chain order.
+     */
+    void post_batch(irq_baton, detail::irq_event_base& first, detail::irq_event_base& last)
+    {
+        assert(first.priority() < num_lanes_);
+#ifdef POLY_CONFIG_RUNTIME_TRACE
+        if(trace_hooks_.on_post)
+        {
+            uint32_t timestamp = trace_timestamp();
+            for(auto* evt = &first; evt != nullptr; evt = evt->next_.load(etl::memory_order_relaxed))
+            {
+                trace_hooks_.on_post(trace_hooks_.context, *evt, timestamp);
+            }
+        }
+#endif
+        if(lane(first.priority()).push_chain(first, last))
+        {
+            notify_ready();
         }
     }
 
     /**
      * @brief Runs all available events.
      *
+     * Events are run from the highest priority non-empty lane. Higher priority lanes are checked again
+     * before each event is run, so a high priority event is never queued behind more than one lower
+     * priority event.
+     *
      * This function returns when there are no more pending events to process.
      */
     void run_available() {
-        while(true)
+        while(auto* evt = pop_highest_priority())
+        {
+            run_event(*evt);
+        }
+    }
+
+    /**
+     * @brief Runs at most `max_events` events.
+     * @param max_events The maximum number of events to run.
+     * @return The number of events that were run.
+     *
+     * Events that are left when the budget is spent stay in their lanes, in order,
+     * and are run by the next call to any of the run functions.
+     */
+    std::size_t run_n(std::size_t max_events) {
+        std::size_t num_run = 0;
+        while(num_run < max_events)
         {
-            // "Take" the entire list of posted events and set the list to empty state
-            // This list is in FILO (First In Last Out) order
-            detail::irq_event_base *head = pending_events_.exchange(nullptr);
-            if(head == nullptr)
+            auto* evt = pop_highest_priority();
+            if(evt == nullptr)
             {
-                // List was empty, do nothing
                 break;
             }
+            run_event(*evt);
+            num_run++;
+        }
+        return num_run;
+    }
 
-            // Reverse the list to ensure we get the events in FIFO order
-            head = reverse_list(head);
-
-            while (head != nullptr) {
-                auto* current = head;
-                head = head->next_;
-                current->run_callback();
+    /**
+     * @brief Runs events until there are no more pending events or `deadline` has passed.
+     * @tparam Clock The clock to use, must provide a static `now()` function.
+     * @param deadline The point in time after which no new event is started.
+     * @return The number of events that were run.
+     *
+     * The deadline is checked before each event, so the call may overrun the deadline by
+     * the duration of one callback. Events that are left stay in their lanes, in order,
+     * and are run by the next call to any of the run functions.
+     */
+    template<class Clock, class Duration>
+    std::size_t run_until(const chrono::time_point<Clock, Duration>& deadline) {
+        std::size_t num_run = 0;
+        while(Clock::now() < deadline)
+        {
+            auto* evt = pop_highest_priority();
+            if(evt == nullptr)
+            {
+                break;
             }
+            run_event(*evt);
+            num_run++;
+        }
+        return num_run;
+    }
+
+    /**
+     * @brief Runs events until there are no more pending events or `timeout` has elapsed.
+     * @tparam Clock The clock to use, must provide a static `now()` function.
+     * @param timeout The time after which no new event is started.
+     * @return The number of events that were run.
+     *
+     * See `run_until`.
+     */
+    template<class Clock, class Rep, class Period>
+    std::size_t run_for(const chrono::duration<Rep, Period>& timeout) {
+        return run_until(Clock::now() + timeout);
+    }
+
+    /**
+     * @brief Sleeps until at least one event is pending.
+     *
+     * How the runtime sleeps is platform specific, see `platform::idle::idle_signal`.
+     * This must only be called from the context that runs the events.
+     */
+    void wait_for_events() {
+        while(!events_available())
+        {
+            idle_signal_.wait();
+        }
+    }
+
+    /**
+     * @brief Sleeps until at least one event is pending or `timeout` has elapsed.
+     * @param timeout The maximum time to sleep.
+     * @return True if events are available.
+     *
+     * The runtime may wake up early, in which case false is returned without waiting for
+     * the rest of the timeout. Not all platforms can enforce the timeout, on those this
+     * returns when any interrupt occurs.
+     */
+    bool wait_for_events(chrono::milliseconds timeout) {
+        if(events_available())
+        {
+            return true;
         }
+        idle_signal_.wait_for(timeout);
+        return events_available();
     }
 
+    /**
+     * @brief Sleeps until an event is pending and runs it.
+     */
+    void run_one_blocking() {
+        wait_for_events();
+        run_n(1);
+    }
+
+#ifdef POLY_PLATFORM_TESTING
+    /**
+     * @brief Get the idle signal of this runtime, to inspect it from tests.
+     * @return The idle signal.
+     */
+    const platform::idle::idle_signal& idle_signal() const {
+        return idle_signal_;
+    }
+#endif
+
+#ifdef POLY_CONFIG_RUNTIME_TRACE
+    /**
+     * @brief Set the trace hooks of this runtime.
+     * @param hooks The new hooks.
+     *
+     * This must be done before any event is posted to the runtime.
+     */
+    void set_trace_hooks(const irq_event_trace_hooks& hooks) {
+        trace_hooks_ = hooks;
+    }
+#endif
+
     /**
      * @brief Checks if any events are pending.
      * @return True if events are available.
      */
     [[nodiscard]] bool events_available() const {
-        return pending_events_.load() != nullptr;
+        for(std::size_t i = 0; i < num_lanes_; i++)
+        {
+            if(!lane(i).empty())
+            {
+                return true;
+            }
+        }
+        return false;
     }
+
+    /**
+     * @brief Get the number of priority levels of this runtime.
+     * @return The number of priority levels. Valid event priorities are `0` to `priority_levels() - 1`.
+     */
+    [[nodiscard]] std::size_t priority_levels() const {
+        return num_lanes_;
+    }
+};
+
+namespace detail
+{
+/**
+ * @brief Storage for lanes 1 and up of a `basic_irq_event_runtime`, lane 0 is part of `irq_event_runtime`.
+ *
+ * This is a base class of the runtime so that it is constructed before `irq_event_runtime`.
+ */
+template<std::size_t NumLanes>
+struct irq_event_lane_storage
+{
+    etl::array<irq_event_lane, NumLanes - 1> lane_storage_;
+
+    irq_event_lane* other_lanes()
+    {
+        return lane_storage_.data();
+    }
+};
+
+template<>
+struct irq_event_lane_storage<1>
+{
+    irq_event_lane* other_lanes()
+    {
+        return nullptr;
+    }
+};
+}
+
+/**
+ * @brief An event runtime with `NumPriorities` priority lanes.
+ * @tparam NumPriorities The number of priority lanes.
+ *
+ * Priority `0` is the highest priority, `NumPriorities - 1` the lowest.
+ * All events are bound to a lane when they are initialized.
+ */
+template<std::size_t NumPriorities>
+class basic_irq_event_runtime: private detail::irq_event_lane_storage<NumPriorities>, public irq_event_runtime
+{
+    static_assert(NumPriorities > 0, "A runtime needs at least one priority lane");
+    static_assert(NumPriorities <= 256, "Event priorities are limited to 8 bits");
+public:
+    basic_irq_event_runtime(): irq_event_runtime(this->other_lanes(), NumPriorities) {}
 };
 }
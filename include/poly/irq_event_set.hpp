@@ -21,13 +21,19 @@
 
 #pragma once
 
-#include "etl/array.h"
-#include "etl/queue_spsc_atomic.h"
+#include "etl/atomic.h"
+#include "etl/optional.h"
 
-#include "irq_event.hpp"
+#include "detail/irq_event_base.hpp"
+#include "detail/irq_event_ring.hpp"
+#include "irq_event_overflow.hpp"
 #include "irq_event_runtime.hpp"
+#include "result.hpp"
+#include "string_literal.hpp"
 
+#include <assert.h>
 #include <cstddef>
+#include <cstdint>
 
 namespace poly
 {
@@ -35,38 +41,63 @@ namespace poly
  * @brief A holder for a set of IRQ events.
  * @tparam T The data that can be stored in each IRQ event.
  * @tparam Capacity Number of IRQ events in the set.
+ * @tparam Overflow What to do with a post when the set is full, see `irq_event_overflow`.
+ * @tparam Ring The ring storing the posted data, see `irq_event_mpmc_set` for a set that can be posted to from
+ * several contexts.
+ *
+ * The set is a single event posted to the runtime together with a ring of `T`, so each slot only costs the
+ * memory of its data. The event is posted when the set goes from empty to pending, and the runtime calls the
+ * callback once for each item that was pending when the event started running.
+ *
+ * The set counts posted and dropped items and the highest number of pending items, so that the capacity can
+ * be sized from real traffic. The counters may be read from any context.
+ *
+ * The default set may only be posted to from one context at a time. See `irq_event_batch_set` for a set that
+ * delivers all pending items to one callback.
  */
-template<class T, std::size_t Capacity>
-class irq_event_set
+template<class T, std::size_t Capacity, irq_event_overflow Overflow = irq_event_overflow::reject,
+         class Ring = detail::irq_event_default_ring_t<T, Capacity, Overflow>>
+class irq_event_set final: public detail::irq_event_base
 {
-    struct irq_event_set_data
-    {
-        irq_event_set<T, Capacity>* event_set;
-        irq_event<irq_event_set_data>* event;
-        etl::optional<T> data;
-    };
-
-    void (*event_callback_)(etl::optional<T>);
+    static_assert(Capacity > 0, "irq_event_set must have a capacity");
 
-    etl::array<irq_event<irq_event_set_data>, Capacity> events_;
-    etl::queue_spsc_atomic<irq_event<irq_event_set_data>*, Capacity> available_events_;
+    etl::atomic<bool> is_posted_{};
+    void (*event_callback_)(etl::optional<T>) = nullptr;
+    irq_event_runtime* rt_ = nullptr;
+    Ring ring_;
+    etl::atomic<uint32_t> posted_count_{0};
+    etl::atomic<uint32_t> dropped_count_{0};
+    etl::atomic<uint32_t> high_watermark_{0};
 
-    static void internal_rt_callback(etl::optional<irq_event_set_data> evt_set_data)
+    void update_high_watermark(std::size_t occupancy)
     {
-        if (evt_set_data)
+        auto value = static_cast<uint32_t>(occupancy);
+        uint32_t current = high_watermark_.load(etl::memory_order_relaxed);
+        while (current < value && !high_watermark_.compare_exchange_weak(current, value, etl::memory_order_relaxed))
         {
-            evt_set_data->event_set->run_event_callback(etl::move(*evt_set_data));
         }
     }
 
-    void run_event_callback(irq_event_set_data evt_set_data)
+    static void run_event(detail::irq_event_base& base)
     {
-        available_events_.push(evt_set_data.event);
-        event_callback_(etl::move(evt_set_data.data));
+        auto& self = static_cast<irq_event_set&>(base);
+        // Cleared before taking items, a post after this posts the event again.
+        self.is_posted_.store(false);
+
+        // Bounded so that a producer posting as fast as the callback runs cannot starve the runtime.
+        for (std::size_t i = 0; i < Capacity; i++)
+        {
+            etl::optional<T> data;
+            if (!self.ring_.pop(data))
+            {
+                break;
+            }
+            self.event_callback_(etl::move(data));
+        }
     }
 
 public:
-    irq_event_set() = default;
+    irq_event_set(): detail::irq_event_base(run_event) {}
     irq_event_set(const irq_event_set&) = delete;
     irq_event_set(irq_event_set&&) = delete;
     irq_event_set& operator=(const irq_event_set&) = delete;
@@ -76,14 +107,12 @@ public:
      * @brief Constructor for the event set.
      * @param rt The runtime associated with the events.
      * @param callback The callback associated with the events. The callback will be called from the runtime.
+     * @param priority The priority lane of the runtime to post the events to, 0 is the highest priority.
      */
-    irq_event_set(irq_event_runtime& rt, void (*callback)(etl::optional<T>)) : event_callback_(callback)
+    irq_event_set(irq_event_runtime& rt, void (*callback)(etl::optional<T>), uint8_t priority = 0)
+        : detail::irq_event_base(run_event), event_callback_(callback), rt_(&rt)
     {
-        for (auto &e : events_)
-        {
-            e.late_init(rt, internal_rt_callback);
-            available_events_.push(&e);
-        }
+        set_priority(priority);
     }
 
     /**
@@ -91,16 +120,14 @@ public:
      *
      * @param rt The runtime associated with this event.
      * @param callback The callback associated with this event set. The callback will be called from the runtime.
+     * @param priority The priority lane of the runtime to post the events to, 0 is the highest priority.
      */
-    void late_init(irq_event_runtime& rt, void (*callback)(etl::optional<T>))
+    void late_init(irq_event_runtime& rt, void (*callback)(etl::optional<T>), uint8_t priority = 0)
     {
+        set_priority(priority);
         event_callback_ = callback;
-
-        for (auto &e : events_)
-        {
-            e.late_init(rt, internal_rt_callback);
-            available_events_.push(&e);
-        }
+        rt_ = &rt;
+        is_posted_.store(false, etl::memory_order_release);
     }
 
     /**
@@ -112,27 +139,74 @@ public:
      */
     poly::result<void, string_literal> post(irq_baton baton, T data)
     {
-        irq_event<irq_event_set_data>* evt;
-        bool found = available_events_.pop(evt);
+        assert(rt_ != nullptr);
 
-        if (found)
+        std::size_t occupancy = 0;
+        auto pushed = ring_.push(etl::move(data), occupancy);
+        if (pushed == detail::irq_event_push_result::rejected)
         {
-            irq_event_set_data set_data;
-            set_data.event_set = this;
-            set_data.event = evt;
-            set_data.data = etl::move(data);
-            if (!evt->try_set_data(baton, etl::move(set_data)))
-            {
-                return poly::error("Failed to set event data"_str);
-            }
+            dropped_count_.fetch_add(1, etl::memory_order_relaxed);
+            return poly::error("Event set full"_str);
+        }
 
-            evt->post(baton);
-            return poly::ok();
+        posted_count_.fetch_add(1, etl::memory_order_relaxed);
+        if (pushed == detail::irq_event_push_result::replaced)
+        {
+            dropped_count_.fetch_add(1, etl::memory_order_relaxed);
         }
-        else
+        update_high_watermark(occupancy);
+
+        bool expected = false;
+        if (is_posted_.compare_exchange_strong(expected, true))
         {
-            return poly::error("Event set full"_str);
+            rt_->post(baton, *this);
         }
+        return poly::ok();
+    }
+
+    /**
+     * @brief Get the number of items that have been accepted by `post`.
+     */
+    uint32_t posted_count()
+    {
+        return posted_count_.load(etl::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Get the number of items that were lost, either rejected or dropped by the overflow policy.
+     */
+    uint32_t dropped_count()
+    {
+        return dropped_count_.load(etl::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Get the highest number of pending items seen by `post`.
+     */
+    uint32_t high_watermark()
+    {
+        return high_watermark_.load(etl::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Reset the posted and dropped counters and the high watermark.
+     */
+    void reset_statistics()
+    {
+        posted_count_.store(0, etl::memory_order_relaxed);
+        dropped_count_.store(0, etl::memory_order_relaxed);
+        high_watermark_.store(0, etl::memory_order_relaxed);
     }
 };
+
+/**
+ * @brief An IRQ event set that any number of contexts may post to concurrently, e.g. interrupts of
+ * different priorities or several threads.
+ *
+ * Each slot has a sequence number in addition to its data, see `detail::irq_event_mpsc_ring`. Posts are
+ * rejected when the set is full.
+ */
+template<class T, std::size_t Capacity>
+using irq_event_mpmc_set =
+    irq_event_set<T, Capacity, irq_event_overflow::reject, detail::irq_event_mpsc_ring<T, Capacity>>;
 }
@@ -0,0 +1,256 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "detail/irq_event_base.hpp"
+
+#include "etl/array.h"
+#include "etl/atomic.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace poly
+{
+/**
+ * @brief Hooks called by `irq_event_runtime` when `POLY_CONFIG_RUNTIME_TRACE` is defined.
+ *
+ * This is implemented as a C struct, like `timer_clock`, so that it can be connected to existing
+ * tracing tools. All hooks are optional. Timestamps are taken from `cycle_counter`, and are 0 if it
+ * isn't set. Timestamps are expected to wrap around.
+ *
+ * `on_post` is called from the context that posts the event, which is normally an interrupt.
+ * `on_run_begin` and `on_run_end` are called from the context that runs the events.
+ */
+struct irq_event_trace_hooks
+{
+    /**
+     * @brief User context passed to all hooks.
+     */
+    void* context = nullptr;
+    /**
+     * @brief Function returning the current value of a free-running cycle counter.
+     */
+    uint32_t (*cycle_counter)() = nullptr;
+    /**
+     * @brief Called before an event is added to the runtime.
+     */
+    void (*on_post)(void* context, const detail::irq_event_base& evt, uint32_t timestamp) = nullptr;
+    /**
+     * @brief Called before the callback of an event is run.
+     */
+    void (*on_run_begin)(void* context, const detail::irq_event_base& evt, uint32_t timestamp) = nullptr;
+    /**
+     * @brief Called after the callback of an event has returned.
+     */
+    void (*on_run_end)(void* context, const detail::irq_event_base& evt, uint32_t timestamp) = nullptr;
+};
+
+/**
+ * @brief A default trace collector for `irq_event_trace_hooks`.
+ * @tparam MaxEvents The number of distinct events to keep statistics for.
+ * @tparam LatencyBuckets The number of buckets in the post to run latency histogram.
+ *
+ * Latencies and durations are measured in cycles of the cycle counter. Latency bucket `i` counts
+ * latencies `l` where `2^(i-1) <= l < 2^i`, bucket 0 counts zero latencies and the last bucket
+ * also counts all latencies that are larger.
+ *
+ * Events posted after `MaxEvents` distinct events have been seen are only counted by `untracked_posts()`.
+ */
+template<size_t MaxEvents, size_t LatencyBuckets = 32>
+class irq_event_trace_collector
+{
+public:
+    /**
+     * @brief Statistics for a single event.
+     */
+    struct event_stats
+    {
+        etl::atomic<const detail::irq_event_base*> event{nullptr};
+        etl::atomic<uint32_t> posts{0};
+        uint32_t runs = 0;
+        uint32_t max_duration = 0;
+        // Written before the event is posted and read when it is run,
+        // the runtime orders the two.
+        uint32_t post_timestamp = 0;
+        uint32_t run_timestamp = 0;
+    };
+private:
+    etl::array<event_stats, MaxEvents> events_;
+    etl::array<uint32_t, LatencyBuckets> latency_histogram_{};
+    etl::atomic<uint32_t> untracked_posts_{0};
+    etl::atomic<uint32_t> pending_depth_{0};
+    etl::atomic<uint32_t> max_pending_depth_{0};
+
+    event_stats* find_or_insert(const detail::irq_event_base& evt)
+    {
+        for(auto& stats: events_)
+        {
+            const detail::irq_event_base* current = stats.event.load(etl::memory_order_acquire);
+            if(current == &evt)
+            {
+                return &stats;
+            }
+            if(current == nullptr)
+            {
+                // Claim the entry, another context may be claiming it at the same time
+                if(stats.event.compare_exchange_strong(current, &evt) || current == &evt)
+                {
+                    return &stats;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    event_stats* find(const detail::irq_event_base& evt)
+    {
+        for(auto& stats: events_)
+        {
+            const detail::irq_event_base* current = stats.event.load(etl::memory_order_acquire);
+            if(current == &evt)
+            {
+                return &stats;
+            }
+            if(current == nullptr)
+            {
+                break;
+            }
+        }
+        return nullptr;
+    }
+
+    static size_t latency_bucket(uint32_t latency)
+    {
+        size_t bucket = 0;
+        while(latency != 0 && bucket < LatencyBuckets - 1)
+        {
+            latency >>= 1;
+            bucket++;
+        }
+        return bucket;
+    }
+
+    static void on_post(void* context, const detail::irq_event_base& evt, uint32_t timestamp)
+    {
+        auto* self = static_cast<irq_event_trace_collector*>(context);
+        uint32_t depth = self->pending_depth_.fetch_add(1) + 1;
+        uint32_t max_depth = self->max_pending_depth_.load(etl::memory_order_relaxed);
+        while(depth > max_depth && !self->max_pending_depth_.compare_exchange_weak(max_depth, depth))
+        {
+        }
+
+        if(auto* stats = self->find_or_insert(evt))
+        {
+            stats->post_timestamp = timestamp;
+            stats->posts.fetch_add(1);
+        }
+        else
+        {
+            self->untracked_posts_.fetch_add(1);
+        }
+    }
+
+    static void on_run_begin(void* context, const detail::irq_event_base& evt, uint32_t timestamp)
+    {
+        auto* self = static_cast<irq_event_trace_collector*>(context);
+        self->pending_depth_.fetch_sub(1);
+        if(auto* stats = self->find(evt))
+        {
+            stats->runs++;
+            stats->run_timestamp = timestamp;
+            self->latency_histogram_[latency_bucket(timestamp - stats->post_timestamp)]++;
+        }
+    }
+
+    static void on_run_end(void* context, const detail::irq_event_base& evt, uint32_t timestamp)
+    {
+        auto* self = static_cast<irq_event_trace_collector*>(context);
+        if(auto* stats = self->find(evt))
+        {
+            uint32_t duration = timestamp - stats->run_timestamp;
+            if(duration > stats->max_duration)
+            {
+                stats->max_duration = duration;
+            }
+        }
+    }
+public:
+    irq_event_trace_collector() = default;
+    irq_event_trace_collector(const irq_event_trace_collector&) = delete;
+    irq_event_trace_collector& operator=(const irq_event_trace_collector&) = delete;
+
+    /**
+     * @brief Get hooks that collect into this collector.
+     * @param cycle_counter Function returning the current value of a free-running cycle counter.
+     * @return Hooks to give to `irq_event_runtime::set_trace_hooks`.
+     */
+    irq_event_trace_hooks hooks(uint32_t (*cycle_counter)())
+    {
+        irq_event_trace_hooks retval;
+        retval.context = this;
+        retval.cycle_counter = cycle_counter;
+        retval.on_post = on_post;
+        retval.on_run_begin = on_run_begin;
+        retval.on_run_end = on_run_end;
+        return retval;
+    }
+
+    /**
+     * @brief Get the statistics of an event.
+     * @param evt The event.
+     * @return The statistics or nullptr if the event hasn't been posted or isn't tracked.
+     *
+     * This should be called from the context that runs the events.
+     */
+    const event_stats* stats_for(const detail::irq_event_base& evt)
+    {
+        return find(evt);
+    }
+
+    /**
+     * @brief Get the post to run latency histogram.
+     * @return The histogram, see the class documentation for the bucket boundaries.
+     */
+    const etl::array<uint32_t, LatencyBuckets>& latency_histogram() const
+    {
+        return latency_histogram_;
+    }
+
+    /**
+     * @brief Get the number of posts of events that didn't fit in the collector.
+     */
+    uint32_t untracked_posts()
+    {
+        return untracked_posts_.load();
+    }
+
+    /**
+     * @brief Get the highest number of events that have been pending at the same time.
+     */
+    uint32_t max_pending_depth()
+    {
+        return max_pending_depth_.load();
+    }
+};
+}
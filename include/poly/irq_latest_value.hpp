@@ -0,0 +1,132 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "etl/array.h"
+#include "etl/atomic.h"
+
+#include "detail/irq_event_base.hpp"
+#include "irq_event_runtime.hpp"
+
+#include <assert.h>
+#include <cstdint>
+
+namespace poly
+{
+/**
+ * @brief An IRQ event that only keeps the latest value, for high rate data such as sensor samples.
+ * @tparam T The stored value. Must be default constructible and move assignable.
+ *
+ * The value is stored in a triple buffer. The producer writes into its back buffer and swaps it with the
+ * middle buffer, the runtime swaps the middle buffer with its front buffer before calling the callback.
+ * Setting a value never fails and never waits for the runtime, and the runtime never waits for the producer.
+ * The value is moved once into the back buffer and the callback gets a reference to the front buffer.
+ *
+ * Values set before the runtime has handled the event overwrite each other, so only the latest one is seen.
+ * Only one context may set values at a time.
+ */
+template<class T>
+class irq_latest_value final: public detail::irq_event_base
+{
+    static constexpr uint8_t index_mask = 0x03;
+    static constexpr uint8_t fresh_bit = 0x04;
+
+    etl::atomic<bool> is_posted_{};
+    // Index of the middle buffer, with `fresh_bit` set when it holds a value the runtime has not seen.
+    etl::atomic<uint8_t> middle_{1};
+    uint8_t back_ = 0;
+    uint8_t front_ = 2;
+    void (*cb_)(T&) = nullptr;
+    irq_event_runtime *rt_ = nullptr;
+    etl::array<T, 3> buffers_;
+
+    static void run_event(detail::irq_event_base& base)
+    {
+        auto& self = static_cast<irq_latest_value&>(base);
+        // Cleared before swapping, a value set after this posts the event again.
+        self.is_posted_.store(false);
+
+        if((self.middle_.load() & fresh_bit) == 0)
+        {
+            return;
+        }
+
+        self.front_ = self.middle_.exchange(self.front_) & index_mask;
+        self.cb_(self.buffers_[self.front_]);
+    }
+
+public:
+    irq_latest_value(): detail::irq_event_base(run_event) {}
+    irq_latest_value(const irq_latest_value&) = delete;
+    irq_latest_value& operator=(const irq_latest_value&) = delete;
+
+    /**
+     * @brief Constructor for the event.
+     * @param rt The runtime associated with this event.
+     * @param callback The callback associated with this event. The callback will be called from the runtime.
+     * @param priority The priority lane of the runtime to post this event to, 0 is the highest priority.
+     */
+    irq_latest_value(irq_event_runtime& rt, void (*callback)(T&), uint8_t priority = 0)
+        : detail::irq_event_base(run_event), cb_(callback), rt_(&rt)
+    {
+        set_priority(priority);
+    }
+
+    /**
+     * @brief Late initialization when event is constructed with default constructor.
+     *
+     * @param rt The runtime associated with this event.
+     * @param callback The callback associated with this event. The callback will be called from the runtime.
+     * @param priority The priority lane of the runtime to post this event to, 0 is the highest priority.
+     */
+    void late_init(irq_event_runtime& rt, void (*callback)(T&), uint8_t priority = 0)
+    {
+        set_priority(priority);
+        cb_ = callback;
+        rt_ = &rt;
+        back_ = 0;
+        front_ = 2;
+        middle_.store(1, etl::memory_order_relaxed);
+        is_posted_.store(false, etl::memory_order_release);
+    }
+
+    /**
+     * @brief Set the latest value and post the event to the associated runtime if it is not already posted.
+     * @param baton IRQ baton.
+     * @param value The new value, replaces any value the runtime has not handled yet.
+     */
+    void set(irq_baton baton, T value)
+    {
+        assert(rt_ != nullptr);
+
+        buffers_[back_] = etl::move(value);
+        back_ = middle_.exchange(static_cast<uint8_t>(back_ | fresh_bit)) & index_mask;
+
+        bool expected = false;
+        if(is_posted_.compare_exchange_strong(expected, true))
+        {
+            rt_->post(baton, *this);
+        }
+    }
+};
+}
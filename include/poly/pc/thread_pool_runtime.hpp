@@ -0,0 +1,232 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "poly/detail/irq_event_list.hpp"
+#include "poly/irq_event_runtime.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace poly::pc
+{
+/**
+ * @brief An event runtime that runs events on a pool of worker threads.
+ * @tparam NumPriorities The number of priority lanes, see `basic_irq_event_runtime`.
+ *
+ * This has the same `post` interface as `irq_event_runtime`, so existing `irq_event`s can be bound to it
+ * and run on several threads. Each worker has its own queue of events. An idle worker takes all pending
+ * events from the runtime lanes, in priority order, into its own queue. Workers whose queues are empty
+ * steal the oldest event from the queues of other workers.
+ *
+ * The worker queues are intrusive lists protected by a mutex each, not lock-free work-stealing deques.
+ * This keeps the events unchanged, but workers contend on the queue of a busy worker while stealing.
+ * Priorities are only honoured when events are taken from the lanes, an event already in a worker queue
+ * is not overtaken by a higher priority event that is posted later.
+ *
+ * Events are started in FIFO order within a lane, but may complete in any order, and an event that is
+ * posted again while its callback runs may run concurrently with itself. Callbacks that share state must
+ * synchronize, e.g. by binding their events to a `poly::strand`.
+ *
+ * The run functions of `irq_event_runtime` must not be called on this runtime. Pending events that have
+ * not started when the runtime is destroyed are never run.
+ */
+template<std::size_t NumPriorities>
+class basic_thread_pool_runtime: public basic_irq_event_runtime<NumPriorities>
+{
+    struct worker
+    {
+        std::mutex mutex;
+        detail::irq_event_list queue;
+        std::thread thread;
+    };
+
+    std::size_t num_workers_;
+    std::unique_ptr<worker[]> workers_;
+    // Only one worker at a time may take events from the runtime lanes.
+    std::mutex lanes_mutex_;
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
+    bool stopping_ = false;
+
+    static void on_ready(irq_event_runtime& rt)
+    {
+        static_cast<basic_thread_pool_runtime&>(rt).wake_workers();
+    }
+
+    void wake_workers()
+    {
+        // Taking the lock orders this with a worker that is about to sleep,
+        // it has either seen the new events or is already waiting.
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+        }
+        sleep_cv_.notify_all();
+    }
+
+    /**
+     * @brief Move all pending events from the runtime lanes to the queue of a worker.
+     * @return The number of events that were moved.
+     */
+    std::size_t take_pending(worker& w)
+    {
+        std::unique_lock<std::mutex> lanes_lock(lanes_mutex_, std::try_to_lock);
+        if(!lanes_lock.owns_lock())
+        {
+            // Another worker is already taking the pending events
+            return 0;
+        }
+        std::size_t taken = 0;
+        std::lock_guard<std::mutex> lock(w.mutex);
+        while(auto* evt = this->pop_highest_priority())
+        {
+            w.queue.push_back(*evt);
+            taken++;
+        }
+        return taken;
+    }
+
+    detail::irq_event_base* pop_from(worker& w)
+    {
+        std::lock_guard<std::mutex> lock(w.mutex);
+        return w.queue.pop_front();
+    }
+
+    detail::irq_event_base* steal(std::size_t thief)
+    {
+        for(std::size_t i = 1; i < num_workers_; i++)
+        {
+            if(auto* evt = pop_from(workers_[(thief + i) % num_workers_]))
+            {
+                return evt;
+            }
+        }
+        return nullptr;
+    }
+
+    bool work_available()
+    {
+        {
+            std::lock_guard<std::mutex> lanes_lock(lanes_mutex_);
+            if(this->events_available())
+            {
+                return true;
+            }
+        }
+        for(std::size_t i = 0; i < num_workers_; i++)
+        {
+            std::lock_guard<std::mutex> lock(workers_[i].mutex);
+            if(!workers_[i].queue.empty())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void worker_main(std::size_t index)
+    {
+        worker& me = workers_[index];
+        while(true)
+        {
+            detail::irq_event_base* evt = pop_from(me);
+            if(evt == nullptr && take_pending(me) > 0)
+            {
+                // Let idle workers steal the rest of the events
+                wake_workers();
+                evt = pop_from(me);
+            }
+            if(evt == nullptr)
+            {
+                evt = steal(index);
+            }
+
+            if(evt != nullptr)
+            {
+                this->run_event(*evt);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            if(stopping_)
+            {
+                return;
+            }
+            if(!work_available())
+            {
+                sleep_cv_.wait(lock);
+            }
+        }
+    }
+public:
+    /**
+     * @brief Constructor, starts the worker threads.
+     * @param num_workers The number of worker threads. Defaults to the number of hardware threads.
+     */
+    explicit basic_thread_pool_runtime(std::size_t num_workers = std::thread::hardware_concurrency())
+        : num_workers_(num_workers > 0 ? num_workers : 1), workers_(new worker[num_workers_])
+    {
+        this->set_ready_hook(on_ready);
+        for(std::size_t i = 0; i < num_workers_; i++)
+        {
+            workers_[i].thread = std::thread([this, i]() { worker_main(i); });
+        }
+    }
+
+    basic_thread_pool_runtime(const basic_thread_pool_runtime&) = delete;
+    basic_thread_pool_runtime& operator=(const basic_thread_pool_runtime&) = delete;
+
+    /**
+     * @brief Destructor, stops and joins the worker threads.
+     */
+    ~basic_thread_pool_runtime()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            stopping_ = true;
+        }
+        sleep_cv_.notify_all();
+        for(std::size_t i = 0; i < num_workers_; i++)
+        {
+            workers_[i].thread.join();
+        }
+    }
+
+    /**
+     * @brief Get the number of worker threads.
+     * @return The number of worker threads.
+     */
+    [[nodiscard]] std::size_t num_workers() const
+    {
+        return num_workers_;
+    }
+};
+
+/**
+ * @brief A thread pool runtime with a single priority lane.
+ */
+using thread_pool_runtime = basic_thread_pool_runtime<1>;
+}
@@ -0,0 +1,66 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "poly/chrono.hpp"
+
+namespace poly::platform::idle
+{
+/**
+ * @brief Signal used to put the CPU to sleep until something is posted.
+ *
+ * This uses the event register of the CPU, `SEV` sets the register and `WFE` sleeps until it is set
+ * or any interrupt occurs. A notification made while nobody is waiting is remembered by the register,
+ * so the next wait returns immediately.
+ */
+class idle_signal
+{
+public:
+    /**
+     * @brief Wake up the CPU. May be called from any interrupt priority.
+     */
+    void notify()
+    {
+        __asm volatile("sev" ::: "memory");
+    }
+
+    /**
+     * @brief Sleep until notified or an interrupt occurs.
+     */
+    void wait()
+    {
+        __asm volatile("wfe" ::: "memory");
+    }
+
+    /**
+     * @brief Sleep until notified or an interrupt occurs.
+     * @param timeout Unused, the CPU has no timer of its own to wake it up.
+     *
+     * The timeout cannot be enforced here, some interrupt (e.g. the timer task) must wake the CPU up.
+     */
+    void wait_for(poly::chrono::milliseconds)
+    {
+        wait();
+    }
+};
+}
@@ -0,0 +1,81 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#ifndef POLY_PLATFORM_PC
+#warning "POLY_PLATFORM_PC macro not set, PC platform is assumed"
+#endif
+
+#include "poly/chrono.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace poly::platform::idle
+{
+/**
+ * @brief Signal used to put the thread running an event runtime to sleep until something is posted.
+ *
+ * A notification that is made while nobody is waiting is remembered, so the next wait returns immediately.
+ */
+class idle_signal
+{
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool notified_ = false;
+public:
+    /**
+     * @brief Wake up the waiting thread. May be called from any thread.
+     */
+    void notify()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            notified_ = true;
+        }
+        cv_.notify_one();
+    }
+
+    /**
+     * @brief Sleep until notified.
+     */
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return notified_; });
+        notified_ = false;
+    }
+
+    /**
+     * @brief Sleep until notified or until `timeout` has elapsed.
+     * @param timeout The maximum time to sleep.
+     */
+    void wait_for(poly::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait_for(lock, std::chrono::milliseconds(timeout.count()), [this]() { return notified_; });
+        notified_ = false;
+    }
+};
+}
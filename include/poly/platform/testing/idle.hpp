@@ -0,0 +1,94 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "poly/chrono.hpp"
+
+#include "etl/atomic.h"
+
+#include <stddef.h>
+
+namespace poly::platform::idle
+{
+/**
+ * @brief Hook called instead of sleeping, to simulate an interrupt while the runtime is idle.
+ */
+inline void (*wait_hook)() = nullptr;
+
+/**
+ * @brief Set the hook that is called whenever an `idle_signal` would sleep.
+ * @param hook The hook to call, or nullptr to do nothing.
+ */
+inline void set_wait_hook(void (*hook)())
+{
+    wait_hook = hook;
+}
+
+/**
+ * @brief Stub signal that never sleeps. Calls the wait hook and counts calls instead.
+ *
+ * The counters are atomic since events may be posted from several threads in tests.
+ */
+class idle_signal
+{
+    mutable etl::atomic<size_t> notify_count_{0};
+    mutable etl::atomic<size_t> wait_count_{0};
+public:
+    void notify()
+    {
+        notify_count_++;
+    }
+
+    void wait()
+    {
+        wait_count_++;
+        if(wait_hook)
+        {
+            wait_hook();
+        }
+    }
+
+    void wait_for(poly::chrono::milliseconds)
+    {
+        wait();
+    }
+
+    /**
+     * @brief Get the number of times the signal has been notified.
+     * @return The number of calls to `notify`.
+     */
+    [[nodiscard]] size_t notify_count() const
+    {
+        return notify_count_.load();
+    }
+
+    /**
+     * @brief Get the number of times the signal would have slept.
+     * @return The number of calls to `wait` and `wait_for`.
+     */
+    [[nodiscard]] size_t wait_count() const
+    {
+        return wait_count_.load();
+    }
+};
+}
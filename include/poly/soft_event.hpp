@@ -108,8 +108,6 @@ public:
  * pending listeners. Pending listeners are moved from pending to active by
  * notifying the IRQ event which in turn should process all active listeners
  * and add any new listeners.
- *
- * See `poly/timer.cpp` for a usage example.
  */
 template<class EventT>
 class soft_event_service
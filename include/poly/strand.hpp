@@ -0,0 +1,123 @@
+/**
+* Copyright © 2021 Dalelven Produktutveckling AB
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the “Software”), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+* WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+* IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "detail/irq_event_base.hpp"
+#include "irq_event_runtime.hpp"
+
+#include "etl/atomic.h"
+
+#include <cstddef>
+
+namespace poly
+{
+/**
+ * @brief A serialized execution context on top of another runtime.
+ *
+ * Events are bound to a strand by initializing them with the strand instead of a runtime. Events in the
+ * same strand never run concurrently and run in the order they were posted, while different strands bound
+ * to a multi-threaded runtime such as `poly::pc::thread_pool_runtime` run in parallel. This lets callbacks
+ * share state without a mutex.
+ *
+ * Posted events are kept in the lock-free lane of the strand. When the lane becomes non-empty, the strand
+ * takes its owner flag and posts a single event of its own to the underlying runtime. That event runs up to
+ * `max_events_per_run` events of the strand, releases the owner flag and posts itself again if more events
+ * are pending. Only the owner of the flag takes events from the lane.
+ *
+ * The run functions of `irq_event_runtime` must not be called on a strand.
+ */
+class strand: public irq_event_runtime
+{
+    struct strand_event final: detail::irq_event_base
+    {
+        strand* strand_;
+
+        strand_event(strand& s, uint8_t priority): detail::irq_event_base(run_event), strand_(&s)
+        {
+            set_priority(priority);
+        }
+
+        static void run_event(detail::irq_event_base& base)
+        {
+            static_cast<strand_event&>(base).strand_->run();
+        }
+    };
+
+    irq_event_runtime* executor_;
+    strand_event event_;
+    std::size_t max_events_per_run_;
+    etl::atomic<bool> owned_{false};
+
+    static void on_ready(irq_event_runtime& rt)
+    {
+        static_cast<strand&>(rt).schedule();
+    }
+
+    void schedule()
+    {
+        bool expected = false;
+        if(owned_.compare_exchange_strong(expected, true))
+        {
+            executor_->post(irq_baton{}, event_);
+        }
+    }
+
+    void run()
+    {
+        for(std::size_t i = 0; i < max_events_per_run_; i++)
+        {
+            auto* evt = pop_highest_priority();
+            if(evt == nullptr)
+            {
+                break;
+            }
+            run_event(*evt);
+        }
+
+        owned_.store(false);
+        // An event posted while we were running may have seen the flag set and
+        // not scheduled the strand, so check again after releasing it. Another worker
+        // may already own the strand and be popping, `events_available()` only reads
+        // atomic lane state so this is safe. The flag is only taken again by `schedule()`.
+        if(events_available())
+        {
+            schedule();
+        }
+    }
+public:
+    /**
+     * @brief Constructor for the strand.
+     * @param executor The runtime that runs the events of the strand.
+     * @param priority The priority lane of `executor` used by the strand, 0 is the highest priority.
+     * @param max_events_per_run The maximum number of events run before other events of `executor` get a turn.
+     */
+    explicit strand(irq_event_runtime& executor, uint8_t priority = 0, std::size_t max_events_per_run = 16)
+        : executor_(&executor), event_(*this, priority), max_events_per_run_(max_events_per_run)
+    {
+        set_ready_hook(on_ready);
+    }
+
+    strand(const strand&) = delete;
+    strand& operator=(const strand&) = delete;
+};
+}
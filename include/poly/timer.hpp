@@ -25,11 +25,20 @@
 #include "soft_event.hpp"
 #include "chrono.hpp"
 #include "function.hpp"
+#include "detail/irq_event_base.hpp"
+#include "detail/timer_wheel.hpp"
+
+#include "etl/atomic.h"
 
 namespace poly
 {
+class timer_service;
+
 /**
  * @brief A simple deadline timer that can be used to detect and handle timeouts.
+ *
+ * A timer is driven by the `timer_service` it was constructed with, or by the default
+ * service created by `timer_task::init`.
  */
 class deadline_timer final: public soft_event_base
 {
@@ -40,8 +49,27 @@ public:
     using duration = chrono::milliseconds;
 private:
     duration until_timeout_ = 0_ms;
+    duration slack_ = 0_ms;
+    uint64_t expiry_ = 0;
+    uint32_t period_ = 0;
+    uint32_t missed_periods_ = 0;
+    bool coalesced_ = false;
+    timer_service* service_ = nullptr;
     poly::function<void(deadline_timer&)> callback_{};
+
+    timer_service* service();
 public:
+    /**
+     * @brief Construct a timer driven by the default timer service.
+     */
+    deadline_timer() = default;
+
+    /**
+     * @brief Construct a timer driven by `service`.
+     * @param service The service to use, it must outlive the timer.
+     */
+    explicit deadline_timer(timer_service& service): service_(&service) {}
+
     /**
      * @brief Changes the handler of this callback without starting to wait for a timeout.
      * @param callback The new handler to use.
@@ -53,17 +81,51 @@ public:
     /**
      * @brief Start waiting for a timeout to occur. If a handler is set this handler will be called after timeout.
      * @param timeout The timeout to wait for.
+     * @param slack How much later than `timeout` the handler may be called.
+     *
+     * The timer service uses the slack to let timers expire together, which saves clock wake ups.
      */
-    void async_wait(duration timeout);
+    void async_wait(duration timeout, duration slack = 0_ms);
 
     /**
      * @brief Start waiting for a timeout, using the specified callback.
      * @param callback The new callback to use.
      * @param timeout The timeout of this deadline timer.
+     * @param slack How much later than `timeout` the callback may be called.
+     */
+    void async_wait(const poly::function<void(deadline_timer&)>& callback, duration timeout, duration slack = 0_ms) {
+        set_handler(callback);
+        async_wait(timeout, slack);
+    }
+
+    /**
+     * @brief Start waiting for an absolute deadline. If a handler is set this handler will be called after timeout.
+     * @param deadline The deadline, on the monotonic time of the timer service.
+     *
+     * A deadline that has already passed expires as soon as the timer task runs. Re-arming with
+     * `async_wait_until(get_deadline() + period)` gives a period that does not drift.
+     */
+    void async_wait_until(duration deadline);
+
+    /**
+     * @brief Start waiting for an absolute deadline, using the specified callback.
+     * @param callback The new callback to use.
+     * @param deadline The deadline, on the monotonic time of the timer service.
      */
-    void async_wait(const poly::function<void(deadline_timer&)>& callback, duration timeout) {
+    void async_wait_until(const poly::function<void(deadline_timer&)>& callback, duration deadline) {
         set_handler(callback);
-        async_wait(timeout);
+        async_wait_until(deadline);
+    }
+
+    /**
+     * @brief Get the absolute deadline of the last wait.
+     * @return The deadline, on the monotonic time of the timer service.
+     *
+     * For `async_wait` the deadline is known once the timer task has processed the wait, which happens
+     * before the handler is called.
+     */
+    [[nodiscard]] duration get_deadline() const {
+        return duration(static_cast<int64_t>(expiry_));
     }
 
     /**
@@ -84,13 +146,86 @@ public:
     }
 
     /**
-     * @brief Get the stored time until timeout. This should normally not be called by user code.
-     * @return The currently stored time until timeout.
+     * @brief Get the timeout of the last relative wait. This should normally not be called by user code.
+     * @return The currently stored timeout.
      */
     [[nodiscard]] duration get_timeout() const {
         return until_timeout_;
     }
 
+    /**
+     * @brief Get the slack of the last relative wait. This should normally not be called by user code.
+     * @return The currently stored slack.
+     */
+    [[nodiscard]] duration get_slack() const {
+        return slack_;
+    }
+
+    /**
+     * @brief Set the period in timer ticks, the timer service re-arms a timer with a non-zero period when it expires.
+     * This should normally not be called by user code.
+     * @param period The new period.
+     */
+    void set_period(uint32_t period) {
+        period_ = period;
+    }
+
+    /**
+     * @brief Get the period in timer ticks. This should normally not be called by user code.
+     * @return The currently stored period.
+     */
+    [[nodiscard]] uint32_t get_period() const {
+        return period_;
+    }
+
+    /**
+     * @brief Set the number of periods missed before the current expiry. This should normally not be called by user code.
+     * @param missed The number of missed periods.
+     */
+    void set_missed_periods(uint32_t missed) {
+        missed_periods_ = missed;
+    }
+
+    /**
+     * @brief Get the number of periods missed before the current expiry. This should normally not be called by user code.
+     * @return The currently stored number of missed periods.
+     */
+    [[nodiscard]] uint32_t get_missed_periods() const {
+        return missed_periods_;
+    }
+
+    /**
+     * @brief Set whether the slack moved the expiry later than the timeout. This should normally not be called by user code.
+     * @param coalesced True if the expiry was moved.
+     */
+    void set_coalesced(bool coalesced) {
+        coalesced_ = coalesced;
+    }
+
+    /**
+     * @brief Get whether the slack moved the expiry later than the timeout. This should normally not be called by user code.
+     * @return The currently stored flag.
+     */
+    [[nodiscard]] bool is_coalesced() const {
+        return coalesced_;
+    }
+
+    /**
+     * @brief Set the absolute expiry time in timer ticks. This should normally not be called by user code.
+     * @param expiry The new expiry time.
+     */
+    void set_expiry(uint64_t expiry) {
+        expiry_ = expiry;
+    }
+
+    /**
+     * @brief Get the absolute expiry time in timer ticks. This should normally not be called by user code.
+     * @return The currently stored expiry time.
+     */
+    [[nodiscard]] uint64_t get_expiry() const {
+        return expiry_;
+    }
+
     /**
      * @brief Notify the callback that timeout has occurred. This should normally not be called by user code.
      */
@@ -104,6 +239,11 @@ public:
  *
  * This is implemented as a C struct so that it can be used to interface
  * with existing C code and drivers.
+ *
+ * A clock either sets `start` and `stop`, or `start_with_context` and `stop_with_context`.
+ * The functions without context can only drive the default service created by `timer_task::init`.
+ * `elapsed` or `elapsed_with_context` are optional, and let `timer_service::now` read the time
+ * without stopping the clock.
  */
 struct timer_clock {
     /**
@@ -122,17 +262,306 @@ struct timer_clock {
      * When this function has finished, `irq_callback` must not be called.
      */
     size_t (*stop)() = nullptr;
+    /**
+     * @brief User context passed to `start_with_context` and `stop_with_context`.
+     */
+    void* context = nullptr;
+    /**
+     * @brief Function pointer to a start function, used instead of `start` if set.
+     * @param context The user context.
+     * @param irq_callback The interrupt callback. External code must call this function with `service` after timeout_ms milliseconds.
+     * @param service The service to pass to `irq_callback`.
+     * @param timeout_ms The timeout in milliseconds.
+     */
+    void (*start_with_context)(void* context, void (*irq_callback)(void* service), void* service, size_t timeout_ms) = nullptr;
+    /**
+     * @brief Stops the timer, used instead of `stop` if set.
+     * @param context The user context.
+     * @return The number of milliseconds elapsed since `start_with_context` was called, or 0 if it wasn't called before.
+     */
+    size_t (*stop_with_context)(void* context) = nullptr;
+    /**
+     * @brief Reads the timer without stopping it, optional.
+     * @return The number of milliseconds elapsed since `start` was called.
+     */
+    size_t (*elapsed)() = nullptr;
+    /**
+     * @brief Reads the timer without stopping it, used instead of `elapsed` if set.
+     * @param context The user context.
+     * @return The number of milliseconds elapsed since `start_with_context` was called.
+     */
+    size_t (*elapsed_with_context)(void* context) = nullptr;
+};
+
+/**
+ * @brief Drives a set of deadline timers from one clock, on one runtime.
+ *
+ * Timers are kept in a timing wheel on a monotonic 64-bit millisecond tick. The clock always runs,
+ * towards the next expiry or for `idle_timeout_ms` when no timer is armed, and the tick is advanced
+ * by the time it reports when stopped. A timer started with slack has its expiry rounded to the
+ * coarsest boundary within the slack, so timers with overlapping slack expire in the same wake up.
+ * The clock interrupt posts an event to the runtime, and all timers of the service are started,
+ * cancelled and notified from that runtime, so a service is not shared between threads. Use one
+ * service per runtime to keep timers of different threads apart.
+ *
+ * The service must outlive its timers. A posted event can not be taken back from the runtime, so the
+ * runtime must have run the service since its timers were last started or its clock last expired
+ * when the service is destroyed.
+ */
+class timer_service
+{
+    struct service_event final: detail::irq_event_base
+    {
+        timer_service* service_;
+
+        explicit service_event(timer_service& s): detail::irq_event_base(run_event), service_(&s) {}
+
+        static void run_event(detail::irq_event_base& base)
+        {
+            timer_service& service = *static_cast<service_event&>(base).service_;
+            service.posted_.store(false);
+            service.process();
+        }
+    };
+
+    friend class deadline_timer;
+
+    irq_event_runtime* rt_;
+    timer_clock clk_;
+    service_event event_;
+    etl::atomic<bool> posted_{false};
+    // Block timers from posting the service event while timers are being processed.
+    bool processing_ = false;
+    bool clock_running_ = false;
+    // The tick as of the last time the clock was stopped, and the tick at which it was last started.
+    uint64_t now_ = 0;
+    uint64_t clock_base_ = 0;
+    uint32_t clock_starts_ = 0;
+    uint32_t wakeups_ = 0;
+    uint32_t wakeups_saved_ = 0;
+    // Timers started since the clock was last stopped, their expiry is set once the elapsed time is known.
+    detail::timer_list<deadline_timer> pending_;
+    detail::timer_wheel<deadline_timer> wheel_;
+
+    void post();
+    void process();
+    void rearm_periodic(deadline_timer& timer, uint64_t now);
+    void start_clock(size_t timeout_ms);
+    void restart_clock();
+    size_t stop_clock();
+    [[nodiscard]] uint64_t read_time() const;
+    uint64_t update_time();
+    void add_relative(deadline_timer& timer);
+    void add_absolute(deadline_timer& timer);
+public:
+    /**
+     * The clock timeout in milliseconds while no timer is armed, so the tick keeps moving when idle.
+     */
+    static constexpr size_t idle_timeout_ms = 60000;
+
+    /**
+     * @brief Constructor for the timer service.
+     * @param rt The IRQ runtime to use.
+     * @param clk Clock interface to use.
+     *
+     * This starts the clock with `idle_timeout_ms`.
+     */
+    timer_service(irq_event_runtime& rt, timer_clock clk): rt_(&rt), clk_(clk), event_(*this) {
+        restart_clock();
+    }
+
+    /**
+     * @brief Destructor, stops the clock.
+     */
+    ~timer_service();
+
+    timer_service(const timer_service&) = delete;
+    timer_service& operator=(const timer_service&) = delete;
+
+    /**
+     * @brief The interrupt callback given to `timer_clock::start_with_context`.
+     * @param service The service whose clock has expired.
+     *
+     * This posts the service to its runtime and may be called from an interrupt.
+     */
+    static void clock_irq(void* service);
+
+    /**
+     * @brief Get the monotonic time of the service.
+     * @return The time since the service first started its clock.
+     *
+     * Outside of a timer handler this adds the time read from `timer_clock::elapsed` to the time the
+     * clock was started, the clock keeps running. A clock without `elapsed` gives the time as of the
+     * last time the service processed its timers. From a timer handler it is the time at which the
+     * expired timers are being processed.
+     */
+    [[nodiscard]] deadline_timer::duration now() const {
+        return deadline_timer::duration(static_cast<int64_t>(read_time()));
+    }
+
+    /**
+     * @brief Get the number of times the clock has been started.
+     */
+    [[nodiscard]] uint32_t clock_starts() const {
+        return clock_starts_;
+    }
+
+    /**
+     * @brief Get the number of wake ups in which at least one timer expired.
+     */
+    [[nodiscard]] uint32_t wakeups() const {
+        return wakeups_;
+    }
+
+    /**
+     * @brief Get the number of timers that slack moved into the wake up of another timer.
+     *
+     * Each of these would have needed a wake up of its own without slack. Timers that expire
+     * together because their deadlines are equal are not counted.
+     */
+    [[nodiscard]] uint32_t wakeups_saved() const {
+        return wakeups_saved_;
+    }
+
+    /**
+     * @brief Reset the statistics counters to zero.
+     */
+    void reset_statistics() {
+        clock_starts_ = 0;
+        wakeups_ = 0;
+        wakeups_saved_ = 0;
+    }
+};
+
+/**
+ * @brief A timer that calls its handler once every period.
+ *
+ * Each deadline is computed from the previous deadline rather than from the time the handler ran,
+ * so handler latency does not accumulate as drift. When the timer expires the service re-arms it
+ * directly before calling the handler. If the service runs so late that one or more deadlines have
+ * already passed, those periods are skipped and reported by `missed_periods()`, instead of calling
+ * the handler once for each of them.
+ */
+class periodic_timer
+{
+public:
+    /**
+     * The duration type used by this periodic timer.
+     */
+    using duration = deadline_timer::duration;
+private:
+    deadline_timer timer_;
+    poly::function<void(periodic_timer&)> callback_{};
+
+    void on_expired() {
+        callback_(*this);
+    }
+public:
+    /**
+     * @brief Construct a periodic timer driven by the default timer service.
+     */
+    periodic_timer() {
+        timer_.set_handler([this](deadline_timer&) { on_expired(); });
+    }
+
+    /**
+     * @brief Construct a periodic timer driven by `service`.
+     * @param service The service to use, it must outlive the timer.
+     */
+    explicit periodic_timer(timer_service& service): timer_(service) {
+        timer_.set_handler([this](deadline_timer&) { on_expired(); });
+    }
+
+    periodic_timer(const periodic_timer&) = delete;
+    periodic_timer& operator=(const periodic_timer&) = delete;
+
+    ~periodic_timer() {
+        cancel();
+    }
+
+    /**
+     * @brief Changes the handler of this timer without starting it.
+     * @param callback The new handler to use.
+     */
+    void set_handler(const poly::function<void(periodic_timer&)>& callback) {
+        callback_ = callback;
+    }
+
+    /**
+     * @brief Start the timer, the first deadline is one period from now.
+     * @param period The period, at least 1 ms.
+     */
+    void start(duration period) {
+        if(period.count() <= 0) {
+            period = duration(1);
+        }
+        timer_.async_wait(period);
+        timer_.set_period(static_cast<uint32_t>(period.count()));
+    }
+
+    /**
+     * @brief Start the timer using the specified handler.
+     * @param callback The new handler to use.
+     * @param period The period, at least 1 ms.
+     */
+    void start(const poly::function<void(periodic_timer&)>& callback, duration period) {
+        set_handler(callback);
+        start(period);
+    }
+
+    /**
+     * @brief Stop the timer. This will not call the handler.
+     */
+    void cancel() {
+        timer_.cancel();
+    }
+
+    /**
+     * @brief Get the period of the timer.
+     */
+    [[nodiscard]] duration get_period() const {
+        return duration(static_cast<int64_t>(timer_.get_period()));
+    }
+
+    /**
+     * @brief Get the most recent nominal deadline that has passed, on the monotonic time of the timer service.
+     *
+     * From the handler this is the deadline it is called for.
+     */
+    [[nodiscard]] duration get_deadline() const {
+        return timer_.get_deadline() - get_period();
+    }
+
+    /**
+     * @brief Get the number of periods skipped before the current call of the handler.
+     */
+    [[nodiscard]] uint32_t missed_periods() const {
+        return timer_.get_missed_periods();
+    }
 };
 
 namespace timer_task
 {
 /**
- * @brief Initialize the timer task. This is used to drive all deadline timers.
+ * @brief Initialize the default timer service. This is used to drive all deadline timers without a service of their own.
  * @param rt The IRQ runtime to use.
  * @param clk Clock interface to use.
  *
- * This must be called before any `deadline_timer` starts waiting.
+ * This must be called before any such `deadline_timer` starts waiting. Calling it again destroys the
+ * previous default service first, see `timer_service`.
  */
 void init(irq_event_runtime& rt, timer_clock clk);
+
+/**
+ * @brief Get the default timer service.
+ * @return The service, or nullptr if `init` hasn't been called.
+ */
+timer_service* default_service();
+
+/**
+ * @brief Get the monotonic time of the default timer service.
+ * @return The time since the default service first started its clock, see `timer_service::now`.
+ */
+deadline_timer::duration now();
 }
 }
\ No newline at end of file
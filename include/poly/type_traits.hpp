@@ -76,7 +76,13 @@ namespace poly {
   using std::is_trivial;
   using std::is_trivially_copyable;
   using std::is_standard_layout;
+#if __cplusplus > 201703L
+  // std::is_pod is deprecated in C++20
+  template <class T> struct is_pod
+    : std::integral_constant<bool, std::is_standard_layout<T>::value && std::is_trivial<T>::value> {};
+#else
   using std::is_pod;
+#endif
   using std::is_empty;
   using std::is_polymorphic;
   using std::is_abstract;
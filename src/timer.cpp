@@ -19,87 +19,208 @@
 * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
-#include "poly/irq_event.hpp"
 #include "poly/timer.hpp"
 #include "poly/manual_lifetime.hpp"
+#include "poly/panic.hpp"
 
-// Block async_wait from posting the timer_irq_event.
-static poly::manual_lifetime<poly::irq_event<void>> timer_irq_event_;
-static poly::manual_lifetime<poly::soft_event_service<poly::deadline_timer>> timer_service_;
-static poly::irq_event_runtime* rt_ = nullptr;
-static poly::timer_clock clk_;
+#include <assert.h>
 
-static void clock_irq() {
-    if(!rt_) {
+static poly::manual_lifetime<poly::timer_service> default_service_;
+static poly::timer_service* default_ = nullptr;
+
+static void default_clock_irq() {
+    if(!default_) {
         // Not initialized!
         return;
     }
-    timer_irq_event_->post(poly::irq_baton{});
+    poly::timer_service::clock_irq(default_);
 }
 
-static void irq_event_callback() {
-    if(!rt_) {
-        return;
+namespace poly
+{
+void timer_service::clock_irq(void* service)
+{
+    static_cast<timer_service*>(service)->post();
+}
+
+timer_service::~timer_service()
+{
+    if(clock_running_) {
+        clock_running_ = false;
+        stop_clock();
     }
+    // Else the runtime would run the event of a destroyed service.
+    assert(!posted_.load());
+}
 
-    poly::deadline_timer::duration timeout(static_cast<int64_t>(clk_.stop()));
+void timer_service::post()
+{
+    if(!posted_.exchange(true))
+    {
+        rt_->post(irq_baton{}, event_);
+    }
+}
 
-    etl::optional<poly::deadline_timer::duration> next_timeout;
-    auto maybe_update_next_timeout = [&next_timeout](poly::deadline_timer::duration dur) {
-        if(dur == 0_ms)
-        {
-            return;
-        }
+void timer_service::start_clock(size_t timeout_ms)
+{
+    clock_starts_++;
+    clock_base_ = now_;
+    clock_running_ = true;
+    if(clk_.start_with_context) {
+        clk_.start_with_context(clk_.context, clock_irq, this, timeout_ms);
+    }
+    else if(this == default_) {
+        clk_.start(default_clock_irq, timeout_ms);
+    }
+    else {
+        // A clock without context can only drive the default service.
+        poly::panic();
+    }
+}
 
-        if(next_timeout) {
-            if(dur < *next_timeout) {
-                *next_timeout = dur;
-            }
-        }
-        else {
-            next_timeout = dur;
-        }
-    };
+size_t timer_service::stop_clock()
+{
+    if(clk_.stop_with_context) {
+        return clk_.stop_with_context(clk_.context);
+    }
+    return clk_.stop();
+}
 
-    timer_service_->notify_active_listeners([&](poly::deadline_timer& timer) {
-        if(timeout > timer.get_timeout()) {
-            timer.set_timeout(0_ms);
-        }
-        else {
-            timer.set_timeout(timer.get_timeout() - timeout);
-        }
+void timer_service::restart_clock()
+{
+    auto next = wheel_.next_expiry();
+    start_clock(next ? static_cast<size_t>(*next - now_) : idle_timeout_ms);
+}
 
-        maybe_update_next_timeout(timer.get_timeout());
+uint64_t timer_service::update_time()
+{
+    if(clock_running_) {
+        clock_running_ = false;
+        now_ = clock_base_ + stop_clock();
+    }
+    return now_;
+}
 
-        return timer.get_timeout() == 0_ms;
-    });
+uint64_t timer_service::read_time() const
+{
+    if(processing_ || !clock_running_) {
+        return now_;
+    }
+    if(clk_.elapsed_with_context) {
+        return clock_base_ + clk_.elapsed_with_context(clk_.context);
+    }
+    if(clk_.elapsed) {
+        return clock_base_ + clk_.elapsed();
+    }
+    return now_;
+}
 
-    timer_service_->add_pending_listeners([&](const poly::deadline_timer &timer) {
-        maybe_update_next_timeout(timer.get_timeout());
-        return true;
+void timer_service::process()
+{
+    const uint64_t now = update_time();
+
+    processing_ = true;
+    uint32_t expired = 0;
+    uint32_t coalesced = 0;
+    wheel_.advance(now, [this, now, &expired, &coalesced](deadline_timer& timer) {
+        expired++;
+        coalesced += timer.is_coalesced() ? 1 : 0;
+        if(timer.get_period() != 0) {
+            rearm_periodic(timer, now);
+        }
+        timer.notify();
     });
+    if(expired > 0) {
+        wakeups_++;
+        // The wake up itself is needed by at least one of the expired timers.
+        wakeups_saved_ += coalesced < expired ? coalesced : expired - 1;
+    }
 
-    if(next_timeout) {
-        clk_.start(clock_irq, next_timeout->count());
+    while(deadline_timer* timer = pending_.pop_front()) {
+        const uint64_t earliest = now + static_cast<uint64_t>(timer->get_timeout().count());
+        const uint64_t expiry = detail::coalesce_expiry(earliest, static_cast<uint64_t>(timer->get_slack().count()));
+        timer->set_expiry(expiry);
+        timer->set_coalesced(expiry != earliest);
+        wheel_.insert(*timer);
     }
+    processing_ = false;
+
+    restart_clock();
+}
+
+void timer_service::rearm_periodic(deadline_timer& timer, uint64_t now)
+{
+    // The next deadline follows from the nominal deadline, deadlines that have already passed are skipped.
+    const uint64_t period = timer.get_period();
+    const uint64_t missed = (now - timer.get_expiry()) / period;
+    timer.set_missed_periods(missed > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(missed));
+    timer.set_expiry(timer.get_expiry() + (missed + 1) * period);
+    wheel_.insert(timer);
+}
+
+void timer_service::add_relative(deadline_timer& timer)
+{
+    pending_.push_back(timer);
+    // If this is true we are already in a "post" context and should
+    // not post again
+    if(!processing_)
+    {
+        post();
+    }
+}
+
+void timer_service::add_absolute(deadline_timer& timer)
+{
+    // The deadline does not depend on the time elapsed since the clock was started,
+    // so the timer can go directly into the wheel.
+    wheel_.insert(timer);
+    if(!processing_)
+    {
+        post();
+    }
+}
 }
 
 namespace poly::timer_task
 {
 void init(irq_event_runtime& rt, timer_clock clk)
 {
-    rt_ = &rt;
-    clk_ = clk;
-    timer_irq_event_.emplace(rt, irq_event_callback);
-    timer_service_.emplace(*timer_irq_event_);
+    if(default_) {
+        default_service_.destroy();
+    }
+    // Set before the service is constructed, so that it can start a clock without context.
+    default_ = &*default_service_;
+    default_service_.emplace(rt, clk);
+}
+
+timer_service* default_service()
+{
+    return default_;
+}
+
+deadline_timer::duration now()
+{
+    if(!default_) {
+        return 0_ms;
+    }
+    return default_->now();
 }
 }
 
 namespace poly
 {
-void deadline_timer::async_wait(duration timeout)
+timer_service* deadline_timer::service()
+{
+    if(!service_) {
+        return default_;
+    }
+    return service_;
+}
+
+void deadline_timer::async_wait(duration timeout, duration slack)
 {
-    if(!rt_) {
+    timer_service* service = this->service();
+    if(!service) {
         return;
     }
     if(timeout.count() == 0)
@@ -107,7 +228,26 @@ void deadline_timer::async_wait(duration timeout)
         timeout = duration(1);
     }
 
+    cancel();
     until_timeout_ = timeout;
-    timer_service_->add_listener(*this);
+    slack_ = slack.count() > 0 ? slack : 0_ms;
+    period_ = 0;
+    missed_periods_ = 0;
+    service->add_relative(*this);
+}
+
+void deadline_timer::async_wait_until(duration deadline)
+{
+    timer_service* service = this->service();
+    if(!service) {
+        return;
+    }
+
+    cancel();
+    expiry_ = deadline.count() > 0 ? static_cast<uint64_t>(deadline.count()) : 0;
+    coalesced_ = false;
+    period_ = 0;
+    missed_periods_ = 0;
+    service->add_absolute(*this);
 }
 }
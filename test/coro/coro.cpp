@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+
+#include "poly/coro.hpp"
+#include "poly/irq_event_runtime.hpp"
+
+#include <vector>
+
+namespace
+{
+poly::coro::frame_pool<512, 4> pool;
+
+struct use_pool
+{
+    use_pool()
+    {
+        poly::coro::set_frame_allocator(pool.allocator());
+    }
+
+    ~use_pool()
+    {
+        poly::coro::set_frame_allocator({});
+    }
+};
+
+poly::coro::task<int> read_twice(poly::coro::irq_awaitable<int>& source)
+{
+    int first = co_await source;
+    int second = co_await source;
+    co_return first + second;
+}
+
+poly::coro::task<> sum_reads(poly::coro::irq_awaitable<int>& source, std::vector<int>& results)
+{
+    results.push_back(co_await read_twice(source));
+    results.push_back(co_await read_twice(source));
+}
+}
+
+TEST(Coro, IrqAwaitable)
+{
+    use_pool frames;
+    poly::irq_event_runtime rt;
+    poly::coro::irq_awaitable<int> source(rt);
+    std::vector<int> results;
+
+    auto task = sum_reads(source, results);
+    ASSERT_TRUE(task.valid());
+    task.start();
+    EXPECT_FALSE(task.done());
+
+    // Resumed from the runtime, not from the interrupt
+    EXPECT_TRUE(source.try_post(poly::irq_baton{}, 1));
+    EXPECT_TRUE(results.empty());
+    rt.run_available();
+    EXPECT_TRUE(source.try_post(poly::irq_baton{}, 2));
+    rt.run_available();
+    EXPECT_EQ(results, (std::vector<int>{3}));
+
+    // Data posted before the coroutine waits is kept for the next wait
+    EXPECT_TRUE(source.try_post(poly::irq_baton{}, 10));
+    rt.run_available();
+    EXPECT_TRUE(source.try_post(poly::irq_baton{}, 20));
+    rt.run_available();
+    EXPECT_EQ(results, (std::vector<int>{3, 30}));
+    EXPECT_TRUE(task.done());
+}
+
+TEST(Coro, AwaitStartedTask)
+{
+    use_pool frames;
+    poly::irq_event_runtime rt;
+    poly::coro::irq_awaitable<int> source(rt);
+    static int result = 0;
+    result = 0;
+
+    auto inner = read_twice(source);
+    inner.start();
+    auto outer = [](poly::coro::task<int>& started) -> poly::coro::task<> {
+        result = co_await std::move(started);
+    }(inner);
+    outer.start();
+
+    // Awaiting must not resume the inner task while it waits for its first read
+    EXPECT_EQ(result, 0);
+    EXPECT_TRUE(source.try_post(poly::irq_baton{}, 4));
+    rt.run_available();
+    EXPECT_EQ(result, 0);
+    EXPECT_TRUE(source.try_post(poly::irq_baton{}, 5));
+    rt.run_available();
+    EXPECT_EQ(result, 9);
+    EXPECT_TRUE(outer.done());
+}
+
+TEST(Coro, Signal)
+{
+    use_pool frames;
+    poly::irq_event_runtime rt;
+    poly::coro::irq_awaitable<void> signal(rt);
+    static int steps = 0;
+    steps = 0;
+
+    auto waiter = [](poly::coro::irq_awaitable<void>& sig) -> poly::coro::task<> {
+        steps++;
+        co_await sig;
+        steps++;
+        co_await sig;
+        steps++;
+    };
+
+    auto task = waiter(signal);
+    task.detach();
+    EXPECT_EQ(steps, 1);
+    signal.post(poly::irq_baton{});
+    signal.post(poly::irq_baton{});
+    rt.run_available();
+    EXPECT_EQ(steps, 2);
+    signal.post(poly::irq_baton{});
+    rt.run_available();
+    EXPECT_EQ(steps, 3);
+}
+
+TEST(Coro, FramePool)
+{
+    poly::irq_event_runtime rt;
+    poly::coro::irq_awaitable<int> source(rt);
+    std::vector<int> results;
+
+    // No allocator, no frame
+    EXPECT_FALSE(sum_reads(source, results).valid());
+
+    use_pool frames;
+    std::vector<poly::coro::task<int>> tasks;
+    for(int i = 0; i < 4; i++)
+    {
+        tasks.push_back(read_twice(source));
+        EXPECT_TRUE(tasks.back().valid());
+    }
+    // The pool is exhausted until a frame is freed
+    EXPECT_FALSE(read_twice(source).valid());
+    tasks.pop_back();
+    EXPECT_TRUE(read_twice(source).valid());
+}
+
+namespace
+{
+void (*clock_irq)() = nullptr;
+size_t clock_timeout = 0;
+
+void clock_start(void (*irq_callback)(), size_t timeout_ms)
+{
+    clock_irq = irq_callback;
+    clock_timeout = timeout_ms;
+}
+
+size_t clock_stop()
+{
+    return clock_timeout;
+}
+}
+
+TEST(Coro, TimerWait)
+{
+    use_pool frames;
+    poly::irq_event_runtime rt;
+    poly::timer_clock clk;
+    clk.start = clock_start;
+    clk.stop = clock_stop;
+    poly::timer_task::init(rt, clk);
+
+    poly::deadline_timer timer;
+    static int steps = 0;
+    steps = 0;
+    auto sleeper = [](poly::deadline_timer& t) -> poly::coro::task<> {
+        co_await poly::coro::wait(t, 100_ms);
+        steps++;
+    };
+
+    auto task = sleeper(timer);
+    task.start();
+    rt.run_available();
+    EXPECT_EQ(clock_timeout, 100u);
+    EXPECT_EQ(steps, 0);
+
+    clock_irq();
+    rt.run_available();
+    EXPECT_EQ(steps, 1);
+    EXPECT_TRUE(task.done());
+}
@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+
+#include "poly/irq_closure_pool.hpp"
+#include "poly/irq_event_runtime.hpp"
+
+#include <memory>
+
+TEST(IrqClosurePool, Post)
+{
+    poly::irq_event_runtime rt;
+    poly::irq_closure_pool<2> pool(rt);
+
+    int sum = 0;
+    EXPECT_TRUE(pool.post(poly::irq_baton{}, [&sum]() { sum += 1; }).is_ok());
+    EXPECT_TRUE(pool.post(poly::irq_baton{}, [&sum]() { sum *= 10; }).is_ok());
+    // The pool is exhausted until the posted callables have run
+    EXPECT_TRUE(pool.post(poly::irq_baton{}, [&sum]() { sum += 100; }).is_error());
+
+    rt.run_available();
+    EXPECT_EQ(sum, 10);
+
+    EXPECT_TRUE(pool.post(poly::irq_baton{}, [&sum]() { sum += 5; }).is_ok());
+    rt.run_available();
+    EXPECT_EQ(sum, 15);
+}
+
+TEST(IrqClosurePool, ReleasesCaptures)
+{
+    poly::irq_event_runtime rt;
+    poly::irq_closure_pool<1, sizeof(std::shared_ptr<int>)> pool(rt);
+
+    auto value = std::make_shared<int>(0);
+    EXPECT_TRUE(pool.post(poly::irq_baton{}, [value]() { (*value)++; }).is_ok());
+    EXPECT_EQ(value.use_count(), 2);
+
+    rt.run_available();
+    EXPECT_EQ(*value, 1);
+    EXPECT_EQ(value.use_count(), 1);
+}
+
+TEST(IrqClosurePool, PostFromCallable)
+{
+    static poly::irq_event_runtime rt;
+    static poly::irq_closure_pool<1> pool(rt);
+    static int count = 0;
+
+    count = 0;
+    EXPECT_TRUE(pool.post(poly::irq_baton{}, []() {
+        count++;
+        // The node is still in use while the callable runs
+        EXPECT_TRUE(pool.post(poly::irq_baton{}, []() { count++; }).is_error());
+    }).is_ok());
+    rt.run_available();
+    EXPECT_EQ(count, 1);
+}
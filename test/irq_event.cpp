@@ -3,6 +3,12 @@
 #include "poly/irq_event_runtime.hpp"
 #include "poly/irq_event.hpp"
 
+#include <atomic>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
 TEST(IrqEvent, Ordering)
 {
     static int order = 0;
@@ -29,4 +35,449 @@ TEST(IrqEvent, Ordering)
 
     rt.run_available();
     EXPECT_EQ(order, 3);
-}
\ No newline at end of file
+}
+
+TEST(IrqEvent, PriorityLanes)
+{
+    static int order = 0;
+    static poly::basic_irq_event_runtime<3> rt;
+
+    order = 0;
+    EXPECT_EQ(rt.priority_levels(), 3u);
+
+    static poly::irq_event<void> high(rt, []() {
+        EXPECT_EQ(order, 2);
+        order++;
+    }, 0);
+    poly::irq_event<void> low1(rt, []() {
+        EXPECT_EQ(order, 1);
+        order++;
+        // Posted while running a low priority event, must run before the next low priority event
+        high.post(poly::irq_baton{});
+    }, 2);
+    poly::irq_event<void> low2(rt, []() {
+        EXPECT_EQ(order, 3);
+        order++;
+    }, 2);
+    poly::irq_event<void> medium(rt, []() {
+        EXPECT_EQ(order, 0);
+        order++;
+    }, 1);
+
+    low1.post(poly::irq_baton{});
+    low2.post(poly::irq_baton{});
+    // Posted after the low priority events but runs first
+    medium.post(poly::irq_baton{});
+
+    EXPECT_TRUE(rt.events_available());
+    rt.run_available();
+    EXPECT_EQ(order, 4);
+    EXPECT_FALSE(rt.events_available());
+}
+
+TEST(IrqEvent, RunN)
+{
+    static int order = 0;
+    static poly::irq_event_runtime rt;
+
+    order = 0;
+
+    static poly::irq_event<void> event1(rt, []() {
+        EXPECT_EQ(order % 2, 0);
+        order++;
+    });
+    static poly::irq_event<void> event2(rt, []() {
+        EXPECT_EQ(order % 2, 1);
+        order++;
+        // Reposting from the callback must not starve run_n
+        event1.post(poly::irq_baton{});
+        event2.post(poly::irq_baton{});
+    });
+
+    event1.post(poly::irq_baton{});
+    event2.post(poly::irq_baton{});
+
+    EXPECT_EQ(rt.run_n(3), 3u);
+    EXPECT_EQ(order, 3);
+    EXPECT_TRUE(rt.events_available());
+    EXPECT_EQ(rt.run_n(1), 1u);
+    EXPECT_EQ(order, 4);
+    EXPECT_EQ(rt.run_n(0), 0u);
+    EXPECT_EQ(order, 4);
+}
+
+struct fake_clock
+{
+    using duration = poly::chrono::milliseconds;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = poly::chrono::time_point<fake_clock>;
+
+    static time_point current;
+    static time_point now()
+    {
+        return current;
+    }
+};
+fake_clock::time_point fake_clock::current{};
+
+TEST(IrqEvent, RunUntil)
+{
+    static int count = 0;
+    poly::irq_event_runtime rt;
+
+    count = 0;
+    fake_clock::current = fake_clock::time_point{};
+
+    poly::irq_event<void> event1(rt, []() {
+        count++;
+        fake_clock::current += 10_ms;
+    });
+    poly::irq_event<void> event2(rt, []() {
+        count++;
+        fake_clock::current += 10_ms;
+    });
+    poly::irq_event<void> event3(rt, []() {
+        count++;
+        fake_clock::current += 10_ms;
+    });
+
+    event1.post(poly::irq_baton{});
+    event2.post(poly::irq_baton{});
+    event3.post(poly::irq_baton{});
+
+    EXPECT_EQ(rt.run_until(fake_clock::time_point(15_ms)), 2u);
+    EXPECT_EQ(count, 2);
+    EXPECT_EQ(rt.run_for<fake_clock>(100_ms), 1u);
+    EXPECT_EQ(count, 3);
+    EXPECT_FALSE(rt.events_available());
+}
+
+TEST(IrqEvent, BlockingWait)
+{
+    static int count = 0;
+    static poly::irq_event_runtime rt;
+    static poly::irq_event<void> event(rt, []() {
+        count++;
+    });
+
+    count = 0;
+    // Simulate an interrupt posting the event while the runtime sleeps
+    poly::platform::idle::set_wait_hook([]() {
+        event.post(poly::irq_baton{});
+    });
+
+    auto waits = rt.idle_signal().wait_count();
+    auto notifications = rt.idle_signal().notify_count();
+    rt.run_one_blocking();
+    EXPECT_EQ(count, 1);
+    EXPECT_EQ(rt.idle_signal().wait_count(), waits + 1);
+    EXPECT_EQ(rt.idle_signal().notify_count(), notifications + 1);
+
+    // Events are already pending, no need to sleep
+    event.post(poly::irq_baton{});
+    EXPECT_TRUE(rt.wait_for_events(10_ms));
+    EXPECT_EQ(rt.idle_signal().wait_count(), waits + 1);
+    rt.run_available();
+    EXPECT_EQ(count, 2);
+
+    poly::platform::idle::set_wait_hook(nullptr);
+    EXPECT_FALSE(rt.wait_for_events(10_ms));
+    EXPECT_EQ(rt.idle_signal().wait_count(), waits + 2);
+}
+
+TEST(IrqEvent, NotifyOnlyWhenEmpty)
+{
+    poly::irq_event_runtime rt;
+    poly::irq_event<void> event1(rt, []() {});
+    poly::irq_event<void> event2(rt, []() {});
+
+    event1.post(poly::irq_baton{});
+    event2.post(poly::irq_baton{});
+    EXPECT_EQ(rt.idle_signal().notify_count(), 1u);
+    rt.run_available();
+    event2.post(poly::irq_baton{});
+    EXPECT_EQ(rt.idle_signal().notify_count(), 2u);
+    rt.run_available();
+}
+
+TEST(IrqEvent, NoNotifyWhileDraining)
+{
+    poly::irq_event_runtime rt;
+    poly::irq_event<void> event1(rt, []() {});
+    poly::irq_event<void> event2(rt, []() {});
+    poly::irq_event<void> event3(rt, []() {});
+
+    event1.post(poly::irq_baton{});
+    event2.post(poly::irq_baton{});
+    EXPECT_EQ(rt.idle_signal().notify_count(), 1u);
+    // The consumer has taken the posted events and still has event2 left to run,
+    // so posting is not a transition from empty
+    EXPECT_EQ(rt.run_n(1), 1u);
+    event3.post(poly::irq_baton{});
+    EXPECT_EQ(rt.idle_signal().notify_count(), 1u);
+    EXPECT_EQ(rt.run_n(10), 2u);
+    EXPECT_FALSE(rt.events_available());
+}
+
+TEST(IrqEvent, LaneStorage)
+{
+    // Lane 0 is part of the base, multi-lane runtimes only add the other lanes
+    EXPECT_LE(sizeof(poly::basic_irq_event_runtime<1>), sizeof(poly::irq_event_runtime));
+    EXPECT_LE(sizeof(poly::basic_irq_event_runtime<3>),
+              sizeof(poly::irq_event_runtime) + 2 * sizeof(poly::detail::irq_event_lane));
+}
+
+TEST(IrqEvent, NoVtable)
+{
+    // Events are dispatched through a single function pointer in the base, not a vtable
+    static_assert(!std::is_polymorphic_v<poly::detail::irq_event_base>);
+    static_assert(!std::is_polymorphic_v<poly::irq_event<void>>);
+    static_assert(!std::is_polymorphic_v<poly::irq_event<uint32_t>>);
+
+    // next_, the trampoline and the priority
+    EXPECT_EQ(sizeof(poly::detail::irq_event_base), 3 * sizeof(void*));
+#ifndef _MSC_VER
+    // The posted flag is packed into the tail padding of the base, followed by the callback and runtime pointers
+    EXPECT_EQ(sizeof(poly::irq_event<void>), 5 * sizeof(void*));
+    // A single state byte and small data are packed next to the base, no optional is needed for the data
+    EXPECT_LE(sizeof(poly::irq_event<uint32_t>),
+              sizeof(poly::detail::irq_event_base) + 2 * sizeof(void*) + sizeof(uint32_t));
+#endif
+}
+
+TEST(IrqEvent, TryPost)
+{
+    static std::vector<std::string> received;
+    received.clear();
+    poly::irq_event_runtime rt;
+    poly::irq_event<std::string> event(rt, [](etl::optional<std::string> data) {
+        received.push_back(data ? *data : "none");
+    });
+
+    EXPECT_TRUE(event.try_post(poly::irq_baton{}, "first"));
+    EXPECT_TRUE(event.try_post(poly::irq_baton{}, "second"));
+    EXPECT_EQ(rt.run_n(10), 1u);
+    EXPECT_EQ(received, (std::vector<std::string>{"second"}));
+
+    // Posting without data gives the callback an empty optional
+    event.post(poly::irq_baton{});
+    rt.run_available();
+    EXPECT_EQ(received, (std::vector<std::string>{"second", "none"}));
+
+    EXPECT_TRUE(event.try_set_data(poly::irq_baton{}, "third"));
+    event.post(poly::irq_baton{});
+    rt.run_available();
+    EXPECT_EQ(received, (std::vector<std::string>{"second", "none", "third"}));
+
+    // Data that is never taken is destroyed with the event
+    EXPECT_TRUE(event.try_set_data(poly::irq_baton{}, std::string(100, 'x')));
+}
+
+TEST(IrqEvent, TryPostStress)
+{
+    constexpr int num_posts = 50000;
+    static int last = 0;
+    static bool in_order = true;
+    last = 0;
+    in_order = true;
+
+    poly::irq_event_runtime rt;
+    poly::irq_event<int> event(rt, [](etl::optional<int> data) {
+        if(data)
+        {
+            in_order = in_order && *data > last;
+            last = *data;
+        }
+    });
+
+    std::thread producer([&event]() {
+        for(int i = 1; i <= num_posts;)
+        {
+            if(event.try_post(poly::irq_baton{}, i))
+            {
+                i++;
+            }
+        }
+    });
+
+    while(last < num_posts)
+    {
+        rt.wait_for_events(poly::chrono::milliseconds(1));
+        rt.run_available();
+    }
+    producer.join();
+
+    EXPECT_TRUE(in_order);
+    EXPECT_EQ(last, num_posts);
+}
+
+TEST(IrqEvent, Cancel)
+{
+    static int void_runs = 0;
+    static std::vector<int> received;
+    void_runs = 0;
+    received.clear();
+
+    poly::irq_event_runtime rt;
+    poly::irq_event<void> void_event(rt, []() { void_runs++; });
+    poly::irq_event<int> data_event(rt, [](etl::optional<int> data) { received.push_back(data ? *data : -1); });
+
+    // Nothing to cancel before posting, the generation is still incremented so that
+    // a callback that has already started can tell that its data is stale
+    EXPECT_FALSE(void_event.try_cancel());
+    EXPECT_EQ(void_event.generation(), 1u);
+
+    void_event.post(poly::irq_baton{});
+    EXPECT_TRUE(data_event.try_post(poly::irq_baton{}, 1));
+    EXPECT_TRUE(void_event.try_cancel());
+    EXPECT_TRUE(data_event.try_cancel());
+    EXPECT_FALSE(data_event.try_cancel());
+    EXPECT_EQ(data_event.generation(), 2u);
+
+    rt.run_available();
+    EXPECT_EQ(void_runs, 0);
+    EXPECT_TRUE(received.empty());
+
+    // The data was kept and is delivered with the next post
+    data_event.post(poly::irq_baton{});
+    rt.run_available();
+    EXPECT_EQ(received, (std::vector<int>{1}));
+
+    // Posting a cancelled event before it is skipped revives it, it runs once
+    void_event.post(poly::irq_baton{});
+    EXPECT_TRUE(void_event.try_cancel());
+    void_event.post(poly::irq_baton{});
+    EXPECT_EQ(rt.run_n(10), 1u);
+    EXPECT_EQ(void_runs, 1);
+}
+
+TEST(IrqEvent, CancelWhilePosting)
+{
+    // Yields while the data is written, so that the cancel often lands while try_post holds the lock
+    struct slow_move
+    {
+        int value;
+        explicit slow_move(int v): value(v) {}
+        slow_move(slow_move&& other) noexcept: value(other.value) { std::this_thread::yield(); }
+        slow_move& operator=(slow_move&& other) noexcept
+        {
+            value = other.value;
+            std::this_thread::yield();
+            return *this;
+        }
+    };
+    constexpr int rounds = 20000;
+    static int runs = 0;
+    runs = 0;
+
+    poly::irq_event_runtime rt;
+    poly::irq_event<slow_move> event(rt, [](etl::optional<slow_move>) { runs++; });
+    std::atomic<int> round{0};
+    std::atomic<int> cancelled_round{0};
+    std::atomic<bool> cancelled{false};
+    std::thread canceller([&]() {
+        for(int r = 1; r <= rounds; r++)
+        {
+            while(round.load() != r)
+            {
+                std::this_thread::yield();
+            }
+            cancelled = event.try_cancel();
+            cancelled_round = r;
+        }
+    });
+
+    int mismatches = 0;
+    for(int r = 1; r <= rounds; r++)
+    {
+        round = r;
+        EXPECT_TRUE(event.try_post(poly::irq_baton{}, slow_move(r)));
+        while(cancelled_round.load() != r)
+        {
+            std::this_thread::yield();
+        }
+        // A successful cancel means the callback is skipped, a failed one that it runs
+        const int before = runs;
+        rt.run_available();
+        if(runs - before != (cancelled ? 0 : 1))
+        {
+            mismatches++;
+        }
+    }
+    canceller.join();
+    EXPECT_EQ(mismatches, 0);
+}
+
+TEST(IrqEvent, StaleAfterFailedCancel)
+{
+    static poly::irq_event<uint16_t> event;
+    static bool stale = false;
+    poly::irq_event_runtime rt;
+    event.late_init(rt, [](etl::optional<uint16_t> generation) {
+        // A cancel while the callback runs fails, but the data posted before it is now stale
+        EXPECT_FALSE(event.try_cancel());
+        stale = *generation != event.generation();
+    });
+
+    const auto& const_event = event;
+    EXPECT_TRUE(event.try_post(poly::irq_baton{}, const_event.generation()));
+    rt.run_available();
+    EXPECT_TRUE(stale);
+}
+
+TEST(IrqEvent, Group)
+{
+    static int order = 0;
+    static poly::basic_irq_event_runtime<2> rt;
+
+    order = 0;
+
+    poly::irq_event<void> before(rt, []() {
+        EXPECT_EQ(order, 0);
+        order++;
+    });
+    poly::irq_event<void> event1(rt, []() {
+        EXPECT_EQ(order, 1);
+        order++;
+    });
+    poly::irq_event<void> event2(rt, []() {
+        EXPECT_EQ(order, 2);
+        order++;
+    });
+    poly::irq_event<uint32_t> event3(rt, [](etl::optional<uint32_t> data) {
+        EXPECT_EQ(order, 3);
+        EXPECT_EQ(data, 3u);
+        order++;
+    });
+    poly::irq_event<void> low(rt, []() {
+        EXPECT_EQ(order, 4);
+        order++;
+    }, 1);
+
+    before.post(poly::irq_baton{});
+    auto notifications = rt.idle_signal().notify_count();
+    {
+        poly::irq_event_group group;
+        EXPECT_TRUE(group.empty());
+        event1.post(poly::irq_baton{}, group);
+        event2.post(poly::irq_baton{}, group);
+        // Already in the group, coalesced
+        event1.post(poly::irq_baton{}, group);
+        event3.try_set_data(poly::irq_baton{}, 3);
+        event3.post(poly::irq_baton{}, group);
+        EXPECT_FALSE(group.empty());
+
+        group.post(poly::irq_baton{});
+        EXPECT_TRUE(group.empty());
+        // The lane was not empty, no new notification
+        EXPECT_EQ(rt.idle_signal().notify_count(), notifications);
+
+        // Posted by the destructor
+        low.post(poly::irq_baton{}, group);
+    }
+    EXPECT_EQ(rt.idle_signal().notify_count(), notifications + 1);
+
+    rt.run_available();
+    EXPECT_EQ(order, 5);
+}
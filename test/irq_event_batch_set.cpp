@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+
+#include "poly/irq_event_batch_set.hpp"
+#include "poly/irq_event_runtime.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace
+{
+std::vector<int> received;
+std::vector<std::size_t> batch_sizes;
+
+void on_items(etl::span<int> items)
+{
+    batch_sizes.push_back(items.size());
+    for(auto item: items)
+    {
+        received.push_back(item);
+    }
+}
+}
+
+TEST(IrqEventBatchSet, Batch)
+{
+    received.clear();
+    batch_sizes.clear();
+    poly::irq_event_runtime rt;
+    poly::irq_event_batch_set<int, 4> set(rt, on_items);
+
+    EXPECT_TRUE(set.post(poly::irq_baton{}, 1).is_ok());
+    EXPECT_TRUE(set.post(poly::irq_baton{}, 2).is_ok());
+    EXPECT_TRUE(set.post(poly::irq_baton{}, 3).is_ok());
+    EXPECT_EQ(rt.run_n(10), 1u);
+    EXPECT_EQ(batch_sizes, (std::vector<std::size_t>{3}));
+
+    for(int i = 4; i < 8; i++)
+    {
+        EXPECT_TRUE(set.post(poly::irq_baton{}, i).is_ok());
+    }
+    EXPECT_TRUE(set.post(poly::irq_baton{}, 8).is_error());
+
+    // The items wrap around the end of the ring and are delivered in two spans
+    rt.run_available();
+    EXPECT_EQ(received, (std::vector<int>{1, 2, 3, 4, 5, 6, 7}));
+    EXPECT_EQ(batch_sizes, (std::vector<std::size_t>{3, 1, 3}));
+}
+
+TEST(IrqEventBatchSet, AnyCapacity)
+{
+    received.clear();
+    batch_sizes.clear();
+    poly::irq_event_runtime rt;
+    poly::irq_event_batch_set<int, 3> set(rt, on_items);
+
+    int next = 0;
+    for(int round = 0; round < 5; round++)
+    {
+        EXPECT_TRUE(set.post(poly::irq_baton{}, next++).is_ok());
+        EXPECT_TRUE(set.post(poly::irq_baton{}, next++).is_ok());
+        rt.run_available();
+    }
+    EXPECT_EQ(received, (std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+    EXPECT_EQ(batch_sizes, (std::vector<std::size_t>{2, 1, 1, 2, 2, 1, 1}));
+}
+
+TEST(IrqEventBatchSet, CapacityOne)
+{
+    received.clear();
+    batch_sizes.clear();
+    poly::irq_event_runtime rt;
+    poly::irq_event_batch_set<int, 1> set(rt, on_items);
+
+    for(int i = 0; i < 4; i++)
+    {
+        EXPECT_TRUE(set.post(poly::irq_baton{}, i).is_ok());
+        EXPECT_TRUE(set.post(poly::irq_baton{}, -1).is_error());
+        rt.run_available();
+    }
+    EXPECT_EQ(received, (std::vector<int>{0, 1, 2, 3}));
+    EXPECT_EQ(batch_sizes, (std::vector<std::size_t>{1, 1, 1, 1}));
+}
+
+TEST(IrqEventBatchSet, MultiProducerStress)
+{
+    constexpr int num_producers = 4;
+    constexpr int posts_per_thread = 5000;
+    static std::atomic<long> sum{0};
+    static std::atomic<int> count{0};
+    sum = 0;
+    count = 0;
+
+    poly::irq_event_runtime rt;
+    poly::irq_event_batch_set<int, 16> set(rt, [](etl::span<int> items) {
+        for(auto item: items)
+        {
+            sum += item;
+        }
+        count += static_cast<int>(items.size());
+    });
+
+    std::vector<std::thread> producers;
+    for(int p = 0; p < num_producers; p++)
+    {
+        producers.emplace_back([&set]() {
+            for(int i = 1; i <= posts_per_thread;)
+            {
+                if(set.post(poly::irq_baton{}, i).is_ok())
+                {
+                    i++;
+                }
+                else
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds(10));
+                }
+            }
+        });
+    }
+
+    while(count.load() < num_producers * posts_per_thread)
+    {
+        rt.wait_for_events(poly::chrono::milliseconds(10));
+        rt.run_available();
+    }
+    for(auto& producer: producers)
+    {
+        producer.join();
+    }
+
+    EXPECT_EQ(count.load(), num_producers * posts_per_thread);
+    EXPECT_EQ(sum.load(), static_cast<long>(num_producers) * posts_per_thread * (posts_per_thread + 1) / 2);
+}
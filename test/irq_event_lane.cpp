@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include "poly/detail/irq_event_mpsc_lane.hpp"
+#include "poly/detail/irq_event_stack_lane.hpp"
+
+#include <thread>
+#include <vector>
+
+namespace
+{
+struct test_event final: poly::detail::irq_event_base
+{
+    int producer = 0;
+    int sequence = 0;
+    test_event(): poly::detail::irq_event_base([](poly::detail::irq_event_base&) {}) {}
+};
+}
+
+template<class Lane>
+class IrqEventLane: public ::testing::Test {};
+
+using lane_types = ::testing::Types<poly::detail::irq_event_stack_lane, poly::detail::irq_event_mpsc_lane>;
+TYPED_TEST_SUITE(IrqEventLane, lane_types);
+
+TYPED_TEST(IrqEventLane, Fifo)
+{
+    TypeParam lane;
+    test_event events[3];
+
+    EXPECT_TRUE(lane.empty());
+    EXPECT_EQ(lane.pop(), nullptr);
+
+    EXPECT_TRUE(lane.push(events[0]));
+    EXPECT_FALSE(lane.push(events[1]));
+    EXPECT_FALSE(lane.empty());
+
+    EXPECT_EQ(lane.pop(), &events[0]);
+    // Pushing between pops keeps FIFO order
+    lane.push(events[2]);
+    EXPECT_EQ(lane.pop(), &events[1]);
+    EXPECT_EQ(lane.pop(), &events[2]);
+    EXPECT_EQ(lane.pop(), nullptr);
+    EXPECT_TRUE(lane.empty());
+
+    // Events can be pushed again once popped
+    EXPECT_TRUE(lane.push(events[1]));
+    EXPECT_EQ(lane.pop(), &events[1]);
+    EXPECT_TRUE(lane.empty());
+}
+
+TYPED_TEST(IrqEventLane, MultiProducerStress)
+{
+    constexpr int num_producers = 4;
+    constexpr int events_per_producer = 10000;
+
+    TypeParam lane;
+    std::vector<test_event> events(num_producers * events_per_producer);
+    std::vector<std::thread> producers;
+    for(int p = 0; p < num_producers; p++)
+    {
+        producers.emplace_back([&lane, &events, p]() {
+            for(int i = 0; i < events_per_producer; i++)
+            {
+                auto& evt = events[p * events_per_producer + i];
+                evt.producer = p;
+                evt.sequence = i;
+                lane.push(evt);
+            }
+        });
+    }
+
+    int next_sequence[num_producers] = {};
+    int popped = 0;
+    while(popped < num_producers * events_per_producer)
+    {
+        auto* evt = static_cast<test_event*>(lane.pop());
+        if(evt == nullptr)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        // Events from each producer must be popped in the order they were pushed
+        ASSERT_EQ(evt->sequence, next_sequence[evt->producer]);
+        next_sequence[evt->producer]++;
+        popped++;
+    }
+
+    for(auto& t: producers)
+    {
+        t.join();
+    }
+    EXPECT_EQ(lane.pop(), nullptr);
+    EXPECT_TRUE(lane.empty());
+}
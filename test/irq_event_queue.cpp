@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+
+#include "poly/irq_event_queue.hpp"
+#include "poly/irq_event_runtime.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace
+{
+std::vector<int> received;
+std::vector<std::size_t> batch_sizes;
+
+void on_items(etl::span<int> items)
+{
+    batch_sizes.push_back(items.size());
+    for(auto item: items)
+    {
+        received.push_back(item);
+    }
+}
+}
+
+TEST(IrqEventQueue, NoLoss)
+{
+    received.clear();
+    batch_sizes.clear();
+    poly::irq_event_runtime rt;
+    poly::irq_event_queue<int, 4> queue(rt, on_items);
+
+    EXPECT_TRUE(queue.push(poly::irq_baton{}, 1).is_ok());
+    EXPECT_TRUE(queue.push(poly::irq_baton{}, 2).is_ok());
+    EXPECT_TRUE(queue.push(poly::irq_baton{}, 3).is_ok());
+    EXPECT_EQ(queue.size(), 3u);
+
+    // Posted once for all three items
+    EXPECT_EQ(rt.run_n(10), 1u);
+    EXPECT_EQ(received, (std::vector<int>{1, 2, 3}));
+    EXPECT_EQ(batch_sizes, (std::vector<std::size_t>{3}));
+    EXPECT_EQ(queue.size(), 0u);
+}
+
+TEST(IrqEventQueue, FullAndWrap)
+{
+    received.clear();
+    batch_sizes.clear();
+    poly::irq_event_runtime rt;
+    poly::irq_event_queue<int, 4> queue(rt, on_items);
+
+    EXPECT_TRUE(queue.push(poly::irq_baton{}, 1).is_ok());
+    EXPECT_TRUE(queue.push(poly::irq_baton{}, 2).is_ok());
+    EXPECT_TRUE(queue.push(poly::irq_baton{}, 3).is_ok());
+    rt.run_available();
+
+    for(int i = 4; i < 8; i++)
+    {
+        EXPECT_TRUE(queue.push(poly::irq_baton{}, i).is_ok());
+    }
+    EXPECT_TRUE(queue.push(poly::irq_baton{}, 8).is_error());
+
+    // The items wrap around the end of the ring and are delivered in two spans
+    rt.run_available();
+    EXPECT_EQ(received, (std::vector<int>{1, 2, 3, 4, 5, 6, 7}));
+    EXPECT_EQ(batch_sizes, (std::vector<std::size_t>{3, 1, 3}));
+}
+
+TEST(IrqEventQueue, Stress)
+{
+    static std::atomic<int> next{0};
+    static std::atomic<bool> in_order{true};
+    constexpr int num_items = 20000;
+    next = 0;
+    in_order = true;
+
+    poly::irq_event_runtime rt;
+    poly::irq_event_queue<int, 16> queue(rt, [](etl::span<int> items) {
+        for(auto item: items)
+        {
+            if(item != next.load())
+            {
+                in_order = false;
+            }
+            next++;
+        }
+    });
+
+    std::thread producer([&queue]() {
+        for(int i = 0; i < num_items;)
+        {
+            if(queue.push(poly::irq_baton{}, i).is_ok())
+            {
+                i++;
+            }
+            else
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(10));
+            }
+        }
+    });
+
+    while(next.load() < num_items)
+    {
+        rt.wait_for_events(poly::chrono::milliseconds(10));
+        rt.run_available();
+    }
+    producer.join();
+
+    EXPECT_TRUE(in_order.load());
+    EXPECT_EQ(next.load(), num_items);
+}
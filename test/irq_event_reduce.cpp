@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include "poly/irq_event_reduce.hpp"
+#include "poly/irq_event_runtime.hpp"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace
+{
+template<class T>
+std::vector<T> received;
+
+template<class T>
+void on_value(T value)
+{
+    received<T>.push_back(value);
+}
+}
+
+TEST(IrqEventReduce, Or)
+{
+    received<uint32_t>.clear();
+    poly::irq_event_runtime rt;
+    poly::irq_event_reduce<uint32_t, poly::reduce_or> flags(rt, on_value<uint32_t>);
+
+    flags.post(poly::irq_baton{}, 0x1);
+    flags.post(poly::irq_baton{}, 0x4);
+    flags.post(poly::irq_baton{}, 0x1);
+    EXPECT_EQ(rt.run_n(10), 1u);
+    EXPECT_EQ(received<uint32_t>, (std::vector<uint32_t>{0x5}));
+
+    flags.post(poly::irq_baton{}, 0x2);
+    rt.run_available();
+    EXPECT_EQ(received<uint32_t>, (std::vector<uint32_t>{0x5, 0x2}));
+}
+
+TEST(IrqEventReduce, Max)
+{
+    received<int32_t>.clear();
+    poly::irq_event_runtime rt;
+    poly::irq_event_reduce<int32_t, poly::reduce_max> peak(rt, on_value<int32_t>);
+
+    peak.post(poly::irq_baton{}, -5);
+    peak.post(poly::irq_baton{}, 7);
+    peak.post(poly::irq_baton{}, 3);
+    rt.run_available();
+    EXPECT_EQ(received<int32_t>, (std::vector<int32_t>{7}));
+}
+
+TEST(IrqEventReduce, AddStress)
+{
+    static uint64_t total = 0;
+    constexpr uint64_t posts_per_thread = 50000;
+    total = 0;
+
+    poly::irq_event_runtime rt;
+    poly::irq_event_reduce<uint64_t, poly::reduce_add> counter(rt, [](uint64_t value) { total += value; });
+
+    auto producer = [&counter]() {
+        for(uint64_t i = 0; i < posts_per_thread; i++)
+        {
+            counter.post(poly::irq_baton{}, 1);
+        }
+    };
+    std::thread producer1(producer);
+    std::thread producer2(producer);
+
+    while(total < 2 * posts_per_thread)
+    {
+        rt.wait_for_events(poly::chrono::milliseconds(10));
+        rt.run_available();
+    }
+    producer1.join();
+    producer2.join();
+
+    EXPECT_EQ(total, 2 * posts_per_thread);
+}
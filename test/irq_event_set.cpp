@@ -0,0 +1,222 @@
+#include <gtest/gtest.h>
+
+#include "poly/irq_event_runtime.hpp"
+#include "poly/irq_event_set.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace
+{
+std::vector<int> received;
+
+void on_data(etl::optional<int> data)
+{
+    if(data)
+    {
+        received.push_back(*data);
+    }
+}
+}
+
+TEST(IrqEventSet, Post)
+{
+    received.clear();
+    poly::irq_event_runtime rt;
+    poly::irq_event_set<int, 2> set(rt, on_data);
+
+    EXPECT_TRUE(set.post(poly::irq_baton{}, 1).is_ok());
+    EXPECT_TRUE(set.post(poly::irq_baton{}, 2).is_ok());
+    EXPECT_TRUE(set.post(poly::irq_baton{}, 3).is_error());
+
+    rt.run_available();
+    EXPECT_EQ(received, (std::vector<int>{1, 2}));
+
+    EXPECT_TRUE(set.post(poly::irq_baton{}, 3).is_ok());
+    rt.run_available();
+    EXPECT_EQ(received, (std::vector<int>{1, 2, 3}));
+}
+
+TEST(IrqEventSet, Compact)
+{
+    struct sample
+    {
+        int16_t x, y, z;
+        explicit sample(int16_t v): x(v), y(v), z(v) {}
+    };
+    static std::vector<int16_t> samples;
+    samples.clear();
+
+    poly::irq_event_runtime rt;
+    poly::irq_event_set<sample, 32> set(rt, [](etl::optional<sample> s) { samples.push_back(s->x); });
+
+    // One event for the whole set plus bookkeeping, each slot only stores its data
+    EXPECT_LE(sizeof(set), sizeof(poly::detail::irq_event_base) + 4 * sizeof(void*) + 4 * sizeof(uint32_t) +
+                            32 * sizeof(sample));
+
+    EXPECT_TRUE(set.post(poly::irq_baton{}, sample(1)).is_ok());
+    EXPECT_TRUE(set.post(poly::irq_baton{}, sample(2)).is_ok());
+    EXPECT_EQ(rt.run_n(10), 1u);
+    EXPECT_EQ(samples, (std::vector<int16_t>{1, 2}));
+}
+
+TEST(IrqEventSet, Overflow)
+{
+    poly::irq_event_runtime rt;
+    poly::irq_event_set<int, 3> reject(rt, on_data);
+    poly::irq_event_set<int, 3, poly::irq_event_overflow::drop_oldest> drop_oldest(rt, on_data);
+    poly::irq_event_set<int, 3, poly::irq_event_overflow::overwrite_newest> overwrite_newest(rt, on_data);
+
+    for(int i = 1; i <= 5; i++)
+    {
+        EXPECT_EQ(reject.post(poly::irq_baton{}, i).is_ok(), i <= 3);
+    }
+    received.clear();
+    rt.run_available();
+    EXPECT_EQ(received, (std::vector<int>{1, 2, 3}));
+
+    for(int i = 1; i <= 5; i++)
+    {
+        EXPECT_TRUE(drop_oldest.post(poly::irq_baton{}, i).is_ok());
+    }
+    received.clear();
+    rt.run_available();
+    EXPECT_EQ(received, (std::vector<int>{3, 4, 5}));
+
+    for(int i = 1; i <= 5; i++)
+    {
+        EXPECT_TRUE(overwrite_newest.post(poly::irq_baton{}, i).is_ok());
+    }
+    received.clear();
+    rt.run_available();
+    EXPECT_EQ(received, (std::vector<int>{1, 2, 5}));
+
+    EXPECT_EQ(reject.posted_count(), 3u);
+    EXPECT_EQ(reject.dropped_count(), 2u);
+    EXPECT_EQ(reject.high_watermark(), 3u);
+    EXPECT_EQ(drop_oldest.posted_count(), 5u);
+    EXPECT_EQ(drop_oldest.dropped_count(), 2u);
+    EXPECT_EQ(overwrite_newest.posted_count(), 5u);
+    EXPECT_EQ(overwrite_newest.dropped_count(), 2u);
+
+    reject.reset_statistics();
+    EXPECT_TRUE(reject.post(poly::irq_baton{}, 6).is_ok());
+    EXPECT_EQ(reject.posted_count(), 1u);
+    EXPECT_EQ(reject.dropped_count(), 0u);
+    EXPECT_EQ(reject.high_watermark(), 1u);
+    rt.run_available();
+}
+
+TEST(IrqEventSet, MpmcCapacityOne)
+{
+    received.clear();
+    poly::irq_event_runtime rt;
+    poly::irq_event_mpmc_set<int, 1> set(rt, on_data);
+
+    for(int i = 0; i < 4; i++)
+    {
+        EXPECT_TRUE(set.post(poly::irq_baton{}, i).is_ok());
+        EXPECT_TRUE(set.post(poly::irq_baton{}, -1).is_error());
+        rt.run_available();
+    }
+    EXPECT_EQ(received, (std::vector<int>{0, 1, 2, 3}));
+}
+
+TEST(IrqEventSet, DropOldestStress)
+{
+    constexpr int num_posts = 50000;
+    static int last = 0;
+    static int delivered = 0;
+    static bool in_order = true;
+    last = 0;
+    delivered = 0;
+    in_order = true;
+
+    poly::irq_event_runtime rt;
+    poly::irq_event_set<int, 8, poly::irq_event_overflow::drop_oldest> set(rt, [](etl::optional<int> data) {
+        if(!data || *data <= last)
+        {
+            in_order = false;
+        }
+        last = data ? *data : last;
+        delivered++;
+    });
+
+    std::atomic<bool> done{false};
+    std::thread producer([&set, &done]() {
+        for(int i = 1; i <= num_posts; i++)
+        {
+            (void)set.post(poly::irq_baton{}, i);
+        }
+        done = true;
+    });
+
+    while(!done.load() || rt.events_available())
+    {
+        rt.wait_for_events(poly::chrono::milliseconds(1));
+        rt.run_available();
+    }
+    producer.join();
+    rt.run_available();
+
+    EXPECT_TRUE(in_order);
+    EXPECT_EQ(static_cast<uint32_t>(delivered) + set.dropped_count(), static_cast<uint32_t>(num_posts));
+    EXPECT_EQ(last, num_posts);
+    EXPECT_LE(set.high_watermark(), 8u);
+}
+
+TEST(IrqEventSet, MultiProducerStress)
+{
+    constexpr int posts_per_thread = 5000;
+    static std::atomic<long> sum{0};
+    static std::atomic<int> count{0};
+
+    for(int num_producers: {1, 2, 4, 8})
+    {
+        sum = 0;
+        count = 0;
+        poly::irq_event_runtime rt;
+        poly::irq_event_mpmc_set<int, 8> set(rt, [](etl::optional<int> data) {
+            if(data)
+            {
+                sum += *data;
+                count++;
+            }
+        });
+
+        std::vector<std::thread> producers;
+        for(int p = 0; p < num_producers; p++)
+        {
+            producers.emplace_back([&set]() {
+                for(int i = 1; i <= posts_per_thread;)
+                {
+                    if(set.post(poly::irq_baton{}, i).is_ok())
+                    {
+                        i++;
+                    }
+                    else
+                    {
+                        std::this_thread::sleep_for(std::chrono::microseconds(10));
+                    }
+                }
+            });
+        }
+
+        const int expected_count = num_producers * posts_per_thread;
+        while(count.load() < expected_count)
+        {
+            rt.wait_for_events(poly::chrono::milliseconds(10));
+            rt.run_available();
+        }
+        for(auto& producer: producers)
+        {
+            producer.join();
+        }
+
+        EXPECT_EQ(count.load(), expected_count);
+        EXPECT_EQ(sum.load(), static_cast<long>(num_producers) * posts_per_thread * (posts_per_thread + 1) / 2);
+    }
+}
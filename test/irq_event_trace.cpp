@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include "poly/irq_event.hpp"
+#include "poly/irq_event_runtime.hpp"
+#include "poly/irq_event_trace.hpp"
+
+static uint32_t cycles = 0;
+static uint32_t cycle_counter()
+{
+    return cycles;
+}
+
+TEST(IrqEventTrace, Collector)
+{
+    poly::irq_event_runtime rt;
+    poly::irq_event<void> event1(rt, []() {});
+    poly::irq_event<void> event2(rt, []() {});
+    poly::irq_event<void> event3(rt, []() {});
+
+    poly::irq_event_trace_collector<2, 8> collector;
+    auto hooks = collector.hooks(cycle_counter);
+    EXPECT_EQ(hooks.context, &collector);
+    EXPECT_EQ(hooks.cycle_counter, cycle_counter);
+
+    hooks.on_post(hooks.context, event1, 0);
+    hooks.on_post(hooks.context, event2, 2);
+    hooks.on_post(hooks.context, event3, 3);
+    EXPECT_EQ(collector.max_pending_depth(), 3u);
+    EXPECT_EQ(collector.untracked_posts(), 1u);
+    EXPECT_EQ(collector.stats_for(event3), nullptr);
+
+    hooks.on_run_begin(hooks.context, event1, 5);
+    hooks.on_run_end(hooks.context, event1, 15);
+    hooks.on_run_begin(hooks.context, event2, 15);
+    hooks.on_run_end(hooks.context, event2, 16);
+    hooks.on_run_begin(hooks.context, event3, 16);
+    hooks.on_run_end(hooks.context, event3, 17);
+
+    hooks.on_post(hooks.context, event1, 20);
+    EXPECT_EQ(collector.max_pending_depth(), 3u);
+    hooks.on_run_begin(hooks.context, event1, 20);
+    hooks.on_run_end(hooks.context, event1, 22);
+
+    auto* stats1 = collector.stats_for(event1);
+    ASSERT_NE(stats1, nullptr);
+    EXPECT_EQ(stats1->posts.load(), 2u);
+    EXPECT_EQ(stats1->runs, 2u);
+    EXPECT_EQ(stats1->max_duration, 10u);
+
+    auto* stats2 = collector.stats_for(event2);
+    ASSERT_NE(stats2, nullptr);
+    EXPECT_EQ(stats2->posts.load(), 1u);
+    EXPECT_EQ(stats2->runs, 1u);
+    EXPECT_EQ(stats2->max_duration, 1u);
+
+    // Latencies 5, 13 and 0
+    const auto& histogram = collector.latency_histogram();
+    EXPECT_EQ(histogram[0], 1u);
+    EXPECT_EQ(histogram[3], 1u);
+    EXPECT_EQ(histogram[4], 1u);
+}
+
+#ifdef POLY_CONFIG_RUNTIME_TRACE
+TEST(IrqEventTrace, Runtime)
+{
+    static poly::irq_event_runtime rt;
+    poly::irq_event<void> event(rt, []() {
+        cycles += 100;
+    });
+
+    poly::irq_event_trace_collector<4> collector;
+    rt.set_trace_hooks(collector.hooks(cycle_counter));
+
+    cycles = 0;
+    event.post(poly::irq_baton{});
+    cycles = 10;
+    rt.run_available();
+
+    auto* stats = collector.stats_for(event);
+    ASSERT_NE(stats, nullptr);
+    EXPECT_EQ(stats->runs, 1u);
+    EXPECT_EQ(stats->max_duration, 100u);
+    EXPECT_EQ(collector.latency_histogram()[4], 1u);
+    EXPECT_EQ(collector.max_pending_depth(), 1u);
+
+    rt.set_trace_hooks(poly::irq_event_trace_hooks{});
+}
+#endif
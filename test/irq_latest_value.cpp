@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include "poly/irq_event_runtime.hpp"
+#include "poly/irq_latest_value.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace
+{
+std::vector<int> received;
+
+void on_value(int& value)
+{
+    received.push_back(value);
+}
+}
+
+TEST(IrqLatestValue, KeepsLatest)
+{
+    received.clear();
+    poly::irq_event_runtime rt;
+    poly::irq_latest_value<int> latest(rt, on_value);
+
+    latest.set(poly::irq_baton{}, 1);
+    latest.set(poly::irq_baton{}, 2);
+    latest.set(poly::irq_baton{}, 3);
+    EXPECT_EQ(rt.run_n(10), 1u);
+    EXPECT_EQ(received, (std::vector<int>{3}));
+
+    latest.set(poly::irq_baton{}, 4);
+    rt.run_available();
+    EXPECT_EQ(received, (std::vector<int>{3, 4}));
+    EXPECT_FALSE(rt.events_available());
+}
+
+TEST(IrqLatestValue, Stress)
+{
+    struct sample
+    {
+        uint32_t sequence = 0;
+        uint32_t check = ~uint32_t{0};
+    };
+
+    static constexpr uint32_t num_samples = 200000;
+    static uint32_t last = 0;
+    static bool consistent = true;
+    last = 0;
+    consistent = true;
+
+    poly::irq_event_runtime rt;
+    poly::irq_latest_value<sample> latest(rt, [](sample& s) {
+        // A torn read or an older value than already seen would break these
+        if(s.check != ~s.sequence || s.sequence < last)
+        {
+            consistent = false;
+        }
+        last = s.sequence;
+    });
+
+    std::thread producer([&latest]() {
+        for(uint32_t i = 1; i <= num_samples; i++)
+        {
+            latest.set(poly::irq_baton{}, sample{i, ~i});
+        }
+    });
+
+    while(last < num_samples)
+    {
+        rt.wait_for_events(poly::chrono::milliseconds(10));
+        rt.run_available();
+    }
+    producer.join();
+
+    EXPECT_TRUE(consistent);
+    EXPECT_EQ(last, num_samples);
+}
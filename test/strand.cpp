@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+
+#include "poly/irq_event.hpp"
+#include "poly/pc/thread_pool_runtime.hpp"
+#include "poly/strand.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr int num_events = 500;
+
+struct strand_state
+{
+    // Not atomic, only touched from within the strand
+    int next = 0;
+    bool running = false;
+    bool overlap = false;
+    bool out_of_order = false;
+    std::atomic<int> done{0};
+};
+
+strand_state states[2];
+
+template<int Strand>
+void run_in_strand(etl::optional<int> value)
+{
+    auto& state = states[Strand];
+    if(state.running)
+    {
+        state.overlap = true;
+    }
+    state.running = true;
+    if(!value || *value != state.next)
+    {
+        state.out_of_order = true;
+    }
+    state.next++;
+    std::this_thread::yield();
+    state.running = false;
+    state.done++;
+}
+}
+
+TEST(Strand, Serialized)
+{
+    for(auto& state: states)
+    {
+        state.next = 0;
+        state.running = false;
+        state.overlap = false;
+        state.out_of_order = false;
+        state.done = 0;
+    }
+    poly::pc::thread_pool_runtime rt(4);
+    poly::strand strand1(rt);
+    poly::strand strand2(rt);
+
+    std::unique_ptr<poly::irq_event<int>[]> events1(new poly::irq_event<int>[num_events]);
+    std::unique_ptr<poly::irq_event<int>[]> events2(new poly::irq_event<int>[num_events]);
+    for(int i = 0; i < num_events; i++)
+    {
+        events1[i].late_init(strand1, run_in_strand<0>);
+        events1[i].try_set_data(poly::irq_baton{}, i);
+        events2[i].late_init(strand2, run_in_strand<1>);
+        events2[i].try_set_data(poly::irq_baton{}, i);
+    }
+
+    std::thread producer([&events2]() {
+        for(int i = 0; i < num_events; i++)
+        {
+            events2[i].post(poly::irq_baton{});
+        }
+    });
+    for(int i = 0; i < num_events; i++)
+    {
+        events1[i].post(poly::irq_baton{});
+    }
+    producer.join();
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while((states[0].done.load() < num_events || states[1].done.load() < num_events) &&
+          std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    for(auto& state: states)
+    {
+        EXPECT_EQ(state.done.load(), num_events);
+        EXPECT_FALSE(state.overlap);
+        EXPECT_FALSE(state.out_of_order);
+    }
+}
+
+TEST(Strand, SingleThreadedRuntime)
+{
+    static int count = 0;
+    poly::irq_event_runtime rt;
+    poly::strand strand(rt, 0, 2);
+
+    count = 0;
+    poly::irq_event<void> event1(strand, []() { count++; });
+    poly::irq_event<void> event2(strand, []() { count++; });
+    poly::irq_event<void> event3(strand, []() { count++; });
+
+    event1.post(poly::irq_baton{});
+    event2.post(poly::irq_baton{});
+    event3.post(poly::irq_baton{});
+    EXPECT_TRUE(rt.events_available());
+
+    // At most two events per turn, the strand reposts itself for the third
+    EXPECT_EQ(rt.run_n(1), 1u);
+    EXPECT_EQ(count, 2);
+    rt.run_available();
+    EXPECT_EQ(count, 3);
+    EXPECT_FALSE(rt.events_available());
+}
+
+TEST(Strand, PostWhileReleasing)
+{
+    // One event per turn makes the strand release its owner flag after every event,
+    // while producers keep posting to it from other threads.
+    constexpr int num_producers = 4;
+    constexpr int posts_per_producer = 2000;
+    static bool running = false;
+    static std::atomic<bool> overlap{false};
+    static std::atomic<int> runs[num_producers];
+
+    poly::pc::thread_pool_runtime rt(4);
+    poly::strand strand(rt, 0, 1);
+
+    running = false;
+    overlap = false;
+    poly::irq_event<int> events[num_producers];
+    for(int p = 0; p < num_producers; p++)
+    {
+        runs[p] = 0;
+        events[p].late_init(strand, [](etl::optional<int> producer) {
+            if(running)
+            {
+                overlap = true;
+            }
+            running = true;
+            runs[*producer]++;
+            running = false;
+        });
+    }
+
+    std::vector<std::thread> producers;
+    for(int p = 0; p < num_producers; p++)
+    {
+        producers.emplace_back([&events, p]() {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+            for(int i = 0; i < posts_per_producer; i++)
+            {
+                EXPECT_TRUE(events[p].try_post(poly::irq_baton{}, p));
+                // Wait for the event to run before posting it again, a lost wakeup stalls here
+                while(runs[p].load() <= i && std::chrono::steady_clock::now() < deadline)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for(auto& t: producers)
+    {
+        t.join();
+    }
+
+    for(int p = 0; p < num_producers; p++)
+    {
+        EXPECT_EQ(runs[p].load(), posts_per_producer);
+    }
+    EXPECT_FALSE(overlap.load());
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include "poly/irq_event.hpp"
+#include "poly/pc/thread_pool_runtime.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static std::atomic<int> runs{0};
+
+static void count_run()
+{
+    runs++;
+}
+
+TEST(ThreadPoolRuntime, RunsAllEvents)
+{
+    constexpr int num_events = 1000;
+    constexpr int num_producers = 4;
+
+    runs = 0;
+    poly::pc::thread_pool_runtime rt(4);
+    EXPECT_EQ(rt.num_workers(), 4u);
+
+    std::unique_ptr<poly::irq_event<void>[]> events(new poly::irq_event<void>[num_events]);
+    for(int i = 0; i < num_events; i++)
+    {
+        events[i].late_init(rt, count_run);
+    }
+
+    std::vector<std::thread> producers;
+    for(int p = 0; p < num_producers; p++)
+    {
+        producers.emplace_back([&events, p]() {
+            for(int i = p; i < num_events; i += num_producers)
+            {
+                events[i].post(poly::irq_baton{});
+            }
+        });
+    }
+    for(auto& t: producers)
+    {
+        t.join();
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while(runs.load() < num_events && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(runs.load(), num_events);
+}
+
+TEST(ThreadPoolRuntime, RunsOnWorkerThreads)
+{
+    static std::atomic<bool> on_main{false};
+    static std::thread::id main_id;
+    static std::atomic<int> count{0};
+
+    main_id = std::this_thread::get_id();
+    count = 0;
+    poly::pc::thread_pool_runtime rt(2);
+    poly::irq_event<void> event(rt, []() {
+        if(std::this_thread::get_id() == main_id)
+        {
+            on_main = true;
+        }
+        count++;
+    });
+
+    for(int i = 0; i < 10; i++)
+    {
+        event.post(poly::irq_baton{});
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while(count.load() <= i && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::yield();
+        }
+    }
+    EXPECT_EQ(count.load(), 10);
+    EXPECT_FALSE(on_main.load());
+}
+
+TEST(ThreadPoolRuntime, PriorityLanes)
+{
+    constexpr int num_events = 100;
+
+    runs = 0;
+    poly::pc::basic_thread_pool_runtime<2> rt(2);
+    EXPECT_EQ(rt.priority_levels(), 2u);
+
+    std::unique_ptr<poly::irq_event<void>[]> events(new poly::irq_event<void>[num_events]);
+    for(int i = 0; i < num_events; i++)
+    {
+        events[i].late_init(rt, count_run, static_cast<uint8_t>(i % 2));
+    }
+    for(int i = 0; i < num_events; i++)
+    {
+        events[i].post(poly::irq_baton{});
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while(runs.load() < num_events && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(runs.load(), num_events);
+}
@@ -0,0 +1,642 @@
+#include <gtest/gtest.h>
+
+#include "poly/detail/timer_wheel.hpp"
+#include "poly/irq_event_runtime.hpp"
+#include "poly/soft_event.hpp"
+#include "poly/timer.hpp"
+
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+struct test_timer: public poly::soft_event_base
+{
+    uint64_t expiry = 0;
+    int fired = 0;
+    uint64_t fired_at = 0;
+
+    [[nodiscard]] uint64_t get_expiry() const {
+        return expiry;
+    }
+};
+
+using wheel_type = poly::detail::timer_wheel<test_timer>;
+
+size_t run_until_empty(wheel_type& wheel, std::vector<test_timer*>* order = nullptr)
+{
+    size_t wakeups = 0;
+    while(auto next = wheel.next_expiry())
+    {
+        wakeups++;
+        wheel.advance(*next, [&](test_timer& t) {
+            t.fired++;
+            t.fired_at = wheel.now();
+            if(order)
+            {
+                order->push_back(&t);
+            }
+        });
+    }
+    return wakeups;
+}
+}
+
+TEST(TimerWheel, ExpiresInOrder)
+{
+    const uint64_t expiries[] = {1, 5, 31, 32, 33, 1000, 40000, (uint64_t(1) << 20) + 5, (uint64_t(1) << 22) + 7};
+    std::vector<test_timer> timers(std::size(expiries));
+    wheel_type wheel;
+    // Insert in reverse to make sure the order comes from the wheel
+    for(size_t i = std::size(expiries); i-- > 0;)
+    {
+        timers[i].expiry = expiries[i];
+        wheel.insert(timers[i]);
+    }
+
+    std::vector<test_timer*> order;
+    // Every wake up expires a timer, cascading does not need wake ups of its own
+    EXPECT_EQ(run_until_empty(wheel, &order), timers.size());
+    ASSERT_EQ(order.size(), timers.size());
+    for(size_t i = 0; i < timers.size(); i++)
+    {
+        EXPECT_EQ(order[i], &timers[i]);
+        EXPECT_EQ(timers[i].fired, 1);
+        EXPECT_EQ(timers[i].fired_at, expiries[i]);
+    }
+}
+
+TEST(TimerWheel, Cancel)
+{
+    test_timer a, b;
+    a.expiry = 100;
+    b.expiry = 5000;
+    wheel_type wheel;
+    wheel.insert(a);
+    wheel.insert(b);
+    a.safe_unlink();
+    EXPECT_EQ(wheel.next_expiry(), etl::optional<uint64_t>(5000));
+    b.safe_unlink();
+    EXPECT_FALSE(wheel.next_expiry());
+
+    wheel.advance(10000, [](test_timer& t) { t.fired++; });
+    EXPECT_EQ(a.fired, 0);
+    EXPECT_EQ(b.fired, 0);
+    EXPECT_EQ(wheel.now(), 10000u);
+}
+
+TEST(TimerWheel, RearmInHandler)
+{
+    test_timer t;
+    t.expiry = 10;
+    wheel_type wheel;
+    wheel.insert(t);
+    for(int i = 0; i < 100; i++)
+    {
+        wheel.advance(wheel.now() + 10, [&](test_timer& timer) {
+            timer.fired++;
+            timer.expiry = wheel.now() + 10;
+            wheel.insert(timer);
+        });
+    }
+    EXPECT_EQ(t.fired, 100);
+    EXPECT_EQ(wheel.next_expiry(), etl::optional<uint64_t>(1010));
+}
+
+TEST(TimerWheel, RandomStress)
+{
+    std::mt19937 gen(1234);
+    std::uniform_int_distribution<uint64_t> timeout(0, 3'000'000);
+    std::uniform_int_distribution<uint64_t> step(1, 50'000);
+    std::vector<test_timer> timers(2000);
+    wheel_type wheel;
+    for(auto& t: timers)
+    {
+        t.expiry = timeout(gen);
+        wheel.insert(t);
+    }
+    for(size_t i = 0; i < timers.size(); i += 7)
+    {
+        timers[i].safe_unlink();
+    }
+
+    uint64_t previous = 0;
+    while(wheel.next_expiry())
+    {
+        const uint64_t target = wheel.now() + step(gen);
+        wheel.advance(target, [&](test_timer& t) {
+            t.fired++;
+            t.fired_at = wheel.now();
+            EXPECT_GE(t.fired_at, previous);
+            previous = t.fired_at;
+        });
+    }
+
+    for(size_t i = 0; i < timers.size(); i++)
+    {
+        if(i % 7 == 0)
+        {
+            EXPECT_EQ(timers[i].fired, 0);
+        }
+        else
+        {
+            EXPECT_EQ(timers[i].fired, 1);
+            EXPECT_EQ(timers[i].fired_at, timers[i].expiry);
+        }
+    }
+}
+
+namespace
+{
+void (*clock_irq)() = nullptr;
+size_t clock_timeout = 0;
+size_t clock_elapsed = 0;
+
+void clock_start(void (*irq_callback)(), size_t timeout_ms)
+{
+    clock_irq = irq_callback;
+    clock_timeout = timeout_ms;
+}
+
+size_t clock_stop()
+{
+    size_t elapsed = clock_elapsed;
+    clock_elapsed = 0;
+    return elapsed;
+}
+
+size_t clock_read()
+{
+    return clock_elapsed;
+}
+
+void clock_fire(poly::irq_event_runtime& rt)
+{
+    clock_elapsed = clock_timeout;
+    clock_irq();
+    rt.run_available();
+}
+}
+
+TEST(TimerWheel, DeadlineTimer)
+{
+    poly::irq_event_runtime rt;
+    poly::timer_clock clk;
+    clk.start = clock_start;
+    clk.stop = clock_stop;
+    poly::timer_task::init(rt, clk);
+
+    std::vector<int> fired;
+    poly::deadline_timer a, b, c;
+    a.async_wait([&](poly::deadline_timer&) { fired.push_back(1); }, 10_ms);
+    b.async_wait([&](poly::deadline_timer&) { fired.push_back(2); }, 25_ms);
+    c.async_wait([&](poly::deadline_timer& t) {
+        fired.push_back(3);
+        if(fired.size() < 5)
+        {
+            t.async_wait(40_ms);
+        }
+    }, 40_ms);
+    rt.run_available();
+    EXPECT_EQ(clock_timeout, 10u);
+
+    clock_fire(rt);
+    EXPECT_EQ(fired, std::vector<int>({1}));
+    EXPECT_EQ(clock_timeout, 15u);
+
+    b.cancel();
+    clock_fire(rt);
+    EXPECT_EQ(fired, std::vector<int>({1}));
+
+    while(fired.size() < 5)
+    {
+        clock_fire(rt);
+    }
+    EXPECT_EQ(fired, std::vector<int>({1, 3, 3, 3, 3}));
+    // No timer is armed, the clock keeps running to move the time
+    EXPECT_EQ(clock_timeout, poly::timer_service::idle_timeout_ms);
+}
+
+TEST(TimerWheel, AbsoluteDeadline)
+{
+    poly::irq_event_runtime rt;
+    poly::timer_clock clk;
+    clk.start = clock_start;
+    clk.stop = clock_stop;
+    poly::timer_task::init(rt, clk);
+    EXPECT_EQ(poly::timer_task::now(), 0_ms);
+
+    std::vector<int64_t> fired;
+    poly::deadline_timer periodic;
+    periodic.async_wait_until([&](poly::deadline_timer& t) {
+        fired.push_back(poly::timer_task::now().count());
+        t.async_wait_until(t.get_deadline() + 30_ms);
+    }, 30_ms);
+    rt.run_available();
+    EXPECT_EQ(clock_timeout, 30u);
+
+    // A relative wait started late does not shift the absolute deadlines
+    poly::deadline_timer other;
+    clock_elapsed = 7;
+    other.async_wait([&](poly::deadline_timer& t) {
+        EXPECT_EQ(t.get_deadline(), 17_ms);
+        fired.push_back(-poly::timer_task::now().count());
+    }, 10_ms);
+    rt.run_available();
+    EXPECT_EQ(poly::timer_task::now(), 7_ms);
+    EXPECT_EQ(clock_timeout, 10u);
+
+    for(int i = 0; i < 4; i++)
+    {
+        clock_fire(rt);
+    }
+    EXPECT_EQ(fired, std::vector<int64_t>({-17, 30, 60, 90}));
+    EXPECT_EQ(periodic.get_deadline(), 120_ms);
+    periodic.cancel();
+}
+
+TEST(TimerWheel, IdleDeadline)
+{
+    poly::irq_event_runtime rt;
+    poly::timer_clock clk;
+    clk.start = clock_start;
+    clk.stop = clock_stop;
+    clk.elapsed = clock_read;
+    poly::timer_task::init(rt, clk);
+    rt.run_available();
+    EXPECT_EQ(clock_timeout, poly::timer_service::idle_timeout_ms);
+
+    // The time moves while no timer is armed, both across and within idle timeouts
+    clock_fire(rt);
+    clock_elapsed = 500;
+    EXPECT_EQ(poly::timer_task::now(), 60500_ms);
+    EXPECT_EQ(clock_timeout, poly::timer_service::idle_timeout_ms);
+
+    std::vector<int64_t> fired;
+    poly::deadline_timer timer;
+    timer.async_wait_until([&](poly::deadline_timer&) {
+        fired.push_back(poly::timer_task::now().count());
+    }, poly::timer_task::now() + 100_ms);
+    rt.run_available();
+    EXPECT_EQ(clock_timeout, 100u);
+
+    clock_fire(rt);
+    EXPECT_EQ(fired, std::vector<int64_t>({60600}));
+}
+
+namespace
+{
+struct context_clock
+{
+    void (*irq)(void*) = nullptr;
+    void* service = nullptr;
+    size_t timeout = 0;
+    size_t elapsed = 0;
+
+    static void start(void* context, void (*irq_callback)(void*), void* service, size_t timeout_ms)
+    {
+        auto& self = *static_cast<context_clock*>(context);
+        self.irq = irq_callback;
+        self.service = service;
+        self.timeout = timeout_ms;
+    }
+
+    static size_t stop(void* context)
+    {
+        auto& self = *static_cast<context_clock*>(context);
+        size_t elapsed = self.elapsed;
+        self.elapsed = 0;
+        return elapsed;
+    }
+
+    poly::timer_clock interface()
+    {
+        poly::timer_clock clk;
+        clk.context = this;
+        clk.start_with_context = start;
+        clk.stop_with_context = stop;
+        return clk;
+    }
+};
+
+// A clock on a microsecond counter, which reports whole milliseconds like a hardware timer would.
+struct us_clock
+{
+    void (*irq)(void*) = nullptr;
+    void* service = nullptr;
+    uint64_t us = 0;
+    uint64_t start_us = 0;
+    size_t timeout = 0;
+    bool armed = false;
+
+    static void start(void* context, void (*irq_callback)(void*), void* service, size_t timeout_ms)
+    {
+        auto& self = *static_cast<us_clock*>(context);
+        self.irq = irq_callback;
+        self.service = service;
+        self.start_us = self.us;
+        self.timeout = timeout_ms;
+        self.armed = true;
+    }
+
+    static size_t stop(void* context)
+    {
+        auto& self = *static_cast<us_clock*>(context);
+        self.armed = false;
+        return elapsed(context);
+    }
+
+    static size_t elapsed(void* context)
+    {
+        auto& self = *static_cast<us_clock*>(context);
+        return static_cast<size_t>((self.us - self.start_us) / 1000);
+    }
+
+    void advance(uint64_t delta_us)
+    {
+        us += delta_us;
+        if(armed && us - start_us >= timeout * 1000u)
+        {
+            armed = false;
+            irq(service);
+        }
+    }
+
+    poly::timer_clock interface(bool with_elapsed)
+    {
+        poly::timer_clock clk;
+        clk.context = this;
+        clk.start_with_context = start;
+        clk.stop_with_context = stop;
+        clk.elapsed_with_context = with_elapsed ? elapsed : nullptr;
+        return clk;
+    }
+};
+}
+
+TEST(TimerService, DestroyStopsClock)
+{
+    poly::irq_event_runtime rt;
+    us_clock clock;
+    {
+        poly::timer_service service(rt, clock.interface(true));
+        EXPECT_TRUE(clock.armed);
+        EXPECT_EQ(clock.timeout, poly::timer_service::idle_timeout_ms);
+    }
+    EXPECT_FALSE(clock.armed);
+    EXPECT_EQ(rt.run_n(5), 0u);
+}
+
+TEST(TimerWheel, InitAgain)
+{
+    poly::irq_event_runtime rt;
+    poly::timer_clock clk;
+    clk.start = clock_start;
+    clk.stop = clock_stop;
+    poly::timer_task::init(rt, clk);
+    poly::timer_task::init(rt, clk);
+    EXPECT_EQ(rt.run_n(5), 0u);
+
+    int fired = 0;
+    poly::deadline_timer timer;
+    timer.async_wait([&](poly::deadline_timer&) { fired++; }, 10_ms);
+    EXPECT_EQ(rt.run_n(5), 1u);
+    EXPECT_EQ(clock_timeout, 10u);
+    clock_fire(rt);
+    EXPECT_EQ(fired, 1);
+}
+
+TEST(TimerService, PollNowFasterThanTick)
+{
+    for(bool with_elapsed: {true, false})
+    {
+        poly::irq_event_runtime rt;
+        us_clock clock;
+        poly::timer_service service(rt, clock.interface(with_elapsed));
+        rt.run_available();
+
+        int fired = 0;
+        poly::deadline_timer timer(service);
+        timer.async_wait([&](poly::deadline_timer&) { fired++; }, 10_ms);
+        rt.run_available();
+        const uint32_t starts = service.clock_starts();
+
+        // Reading the time does not stop the clock, so sub-millisecond time is not lost
+        for(int i = 0; i < 40 && fired == 0; i++)
+        {
+            clock.advance(500);
+            const int64_t expected = with_elapsed ? static_cast<int64_t>(clock.us / 1000) : 0;
+            EXPECT_EQ(service.now().count(), expected);
+            rt.run_available();
+        }
+        EXPECT_EQ(fired, 1);
+        EXPECT_EQ(clock.us, 10000u);
+        EXPECT_EQ(service.now(), 10_ms);
+        // Only started again after the timer expired
+        EXPECT_EQ(service.clock_starts(), starts + 1);
+    }
+}
+
+TEST(TimerService, PerThread)
+{
+    constexpr int timers_per_thread = 200;
+    std::vector<int> fired(4, 0);
+    std::vector<int64_t> end_time(4, 0);
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < fired.size(); i++)
+    {
+        threads.emplace_back([&fired, &end_time, i]() {
+            poly::irq_event_runtime rt;
+            context_clock clock;
+            poly::timer_service service(rt, clock.interface());
+            std::vector<poly::deadline_timer> timers;
+            timers.reserve(timers_per_thread);
+            for(int t = 0; t < timers_per_thread; t++)
+            {
+                timers.emplace_back(service);
+                timers.back().async_wait([&fired, i](poly::deadline_timer&) { fired[i]++; },
+                                         poly::deadline_timer::duration(1 + t * 7));
+            }
+            rt.run_available();
+            while(fired[i] < timers_per_thread)
+            {
+                clock.elapsed = clock.timeout;
+                clock.irq(clock.service);
+                rt.run_available();
+            }
+            end_time[i] = service.now().count();
+        });
+    }
+    for(auto& th: threads)
+    {
+        th.join();
+    }
+    for(size_t i = 0; i < fired.size(); i++)
+    {
+        EXPECT_EQ(fired[i], timers_per_thread);
+        EXPECT_EQ(end_time[i], 1 + (timers_per_thread - 1) * 7);
+    }
+}
+
+TEST(TimerWheel, CoalesceExpiry)
+{
+    EXPECT_EQ(poly::detail::coalesce_expiry(10, 0), 10u);
+    EXPECT_EQ(poly::detail::coalesce_expiry(10, 5), 12u);
+    EXPECT_EQ(poly::detail::coalesce_expiry(10, 6), 16u);
+    EXPECT_EQ(poly::detail::coalesce_expiry(1000, 100), 1024u);
+    EXPECT_EQ(poly::detail::coalesce_expiry(1030, 103), 1088u);
+    for(uint64_t e = 1; e < 300; e++)
+    {
+        for(uint64_t slack = 0; slack < 40; slack++)
+        {
+            uint64_t c = poly::detail::coalesce_expiry(e, slack);
+            EXPECT_GE(c, e);
+            EXPECT_LE(c, e + slack);
+        }
+    }
+}
+
+namespace
+{
+struct staggered_result
+{
+    uint32_t clock_starts;
+    uint32_t wakeups;
+    uint32_t wakeups_saved;
+    bool in_range;
+};
+
+// Simulates 500 timers with timeouts staggered 7 ms apart.
+staggered_result run_staggered(int slack_percent)
+{
+    constexpr int num_timers = 500;
+    struct state
+    {
+        poly::irq_event_runtime rt;
+        context_clock clock;
+        poly::timer_service service{rt, clock.interface()};
+        std::vector<int64_t> earliest = std::vector<int64_t>(num_timers);
+        std::vector<int64_t> latest = std::vector<int64_t>(num_timers);
+        int fired = 0;
+        bool in_range = true;
+    } s;
+    std::vector<poly::deadline_timer> timers;
+    timers.reserve(num_timers);
+    for(int t = 0; t < num_timers; t++)
+    {
+        const poly::deadline_timer::duration timeout(1000 + t * 7);
+        const auto slack = timeout * slack_percent / 100;
+        s.earliest[t] = timeout.count();
+        s.latest[t] = timeout.count() + slack.count();
+        timers.emplace_back(s.service);
+        timers[t].async_wait([&s, t](poly::deadline_timer&) {
+            s.fired++;
+            const auto at = s.service.now().count();
+            s.in_range = s.in_range && at >= s.earliest[t] && at <= s.latest[t];
+        }, timeout, slack);
+    }
+    s.rt.run_available();
+
+    while(s.fired < num_timers)
+    {
+        s.clock.elapsed = s.clock.timeout;
+        s.clock.irq(s.clock.service);
+        s.rt.run_available();
+    }
+    return {s.service.clock_starts(), s.service.wakeups(), s.service.wakeups_saved(), s.in_range};
+}
+}
+
+TEST(TimerService, StaggeredSlack)
+{
+    auto exact = run_staggered(0);
+    auto coalesced = run_staggered(10);
+    EXPECT_TRUE(exact.in_range);
+    EXPECT_TRUE(coalesced.in_range);
+    EXPECT_EQ(exact.wakeups + exact.wakeups_saved, 500u);
+    EXPECT_EQ(coalesced.wakeups + coalesced.wakeups_saved, 500u);
+    EXPECT_EQ(exact.wakeups, 500u);
+    // Allowing 10% slack should cut the number of wake ups by at least a factor 4
+    EXPECT_LT(coalesced.wakeups * 4, exact.wakeups);
+    EXPECT_LT(coalesced.clock_starts, exact.clock_starts);
+    RecordProperty("exact_wakeups", static_cast<int>(exact.wakeups));
+    RecordProperty("coalesced_wakeups", static_cast<int>(coalesced.wakeups));
+}
+
+TEST(TimerService, WakeupsSavedOnlyBySlack)
+{
+    poly::irq_event_runtime rt;
+    context_clock clock;
+    poly::timer_service service(rt, clock.interface());
+    auto fire = [&]() {
+        clock.elapsed = clock.timeout;
+        clock.irq(clock.service);
+        rt.run_available();
+    };
+
+    // Equal deadlines share a wake up without any slack
+    poly::deadline_timer a(service), b(service);
+    a.async_wait([](poly::deadline_timer&) {}, 16_ms);
+    b.async_wait([](poly::deadline_timer&) {}, 16_ms);
+    rt.run_available();
+    fire();
+    EXPECT_EQ(service.wakeups(), 1u);
+    EXPECT_EQ(service.wakeups_saved(), 0u);
+
+    // The slack moves b from 10 ms to 16 ms, into the wake up of a
+    a.async_wait(16_ms);
+    b.async_wait(10_ms, 10_ms);
+    rt.run_available();
+    EXPECT_EQ(clock.timeout, 16u);
+    fire();
+    EXPECT_EQ(service.wakeups(), 2u);
+    EXPECT_EQ(service.wakeups_saved(), 1u);
+}
+
+TEST(TimerService, PeriodicTimer)
+{
+    poly::irq_event_runtime rt;
+    context_clock clock;
+    poly::timer_service service(rt, clock.interface());
+    poly::periodic_timer periodic(service);
+
+    std::vector<int64_t> calls;
+    std::vector<int64_t> deadlines;
+    std::vector<uint32_t> missed;
+    periodic.start([&](poly::periodic_timer& t) {
+        calls.push_back(service.now().count());
+        deadlines.push_back(t.get_deadline().count());
+        missed.push_back(t.missed_periods());
+        if(calls.size() == 5)
+        {
+            t.cancel();
+        }
+    }, 30_ms);
+    rt.run_available();
+    EXPECT_EQ(clock.timeout, 30u);
+
+    auto fire = [&](size_t late) {
+        clock.elapsed = clock.timeout + late;
+        clock.irq(clock.service);
+        rt.run_available();
+    };
+
+    fire(0);
+    fire(0);
+    // A late wake up is absorbed without drift
+    fire(7);
+    EXPECT_EQ(clock.timeout, 23u);
+    // A wake up more than a period late skips the missed periods
+    fire(70);
+    EXPECT_EQ(clock.timeout, 20u);
+    const uint32_t starts = service.clock_starts();
+    fire(0);
+    EXPECT_EQ(calls, std::vector<int64_t>({30, 60, 97, 190, 210}));
+    EXPECT_EQ(deadlines, std::vector<int64_t>({30, 60, 90, 180, 210}));
+    EXPECT_EQ(missed, std::vector<uint32_t>({0, 0, 0, 2, 0}));
+    // Cancelled from the handler, so the clock only runs to keep the time moving
+    EXPECT_EQ(service.clock_starts(), starts + 1);
+    EXPECT_EQ(clock.timeout, poly::timer_service::idle_timeout_ms);
+}